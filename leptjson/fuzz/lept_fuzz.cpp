@@ -0,0 +1,693 @@
+/*
+ * Fuzz targets and differential harness for leptjson.
+ *
+ * Every target is LLVMFuzzerTestOneInput, so it runs under libFuzzer, under
+ * AFL++ (afl-clang-fast++ -fsanitize=fuzzer), or standalone. Pick one with
+ * LEPT_FUZZ_TARGET; the default is the differential target, which feeds each
+ * input through every parse mode and aborts on the first disagreement.
+ *
+ *   clang++ -g -O1 -fsanitize=fuzzer,address,undefined -DLEPT_FUZZ_TARGET=LEPT_FUZZ_PARSE \
+ *       -I.. ../leptjson.cpp lept_fuzz.cpp -o fuzz_parse -lpthread
+ *   ./fuzz_parse corpus
+ *
+ * With -DLEPT_FUZZ_STANDALONE (any compiler, e.g. g++ -fsanitize=address,undefined)
+ * main replays the files named on the command line, or runs random generated
+ * inputs when there are none, and also flags inputs whose parse time grows
+ * super-linearly with their size: every corpus file, and a sample of the random ones.
+ */
+#include "leptjson.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEPT_FUZZ_DIFF     0 /* every mode against lept_parse */
+#define LEPT_FUZZ_PARSE    1
+#define LEPT_FUZZ_PARSE_EX 2
+#define LEPT_FUZZ_PARALLEL 3
+#define LEPT_FUZZ_REFORMAT 4
+#define LEPT_FUZZ_CBOR     5 /* raw bytes into the CBOR decoder */
+#define LEPT_FUZZ_PATCH    6 /* input is [document, patch] */
+
+#ifndef LEPT_FUZZ_TARGET
+#define LEPT_FUZZ_TARGET LEPT_FUZZ_DIFF
+#endif
+
+#define FUZZ_CHECK(cond) \
+	do {\
+		if (!(cond)) {\
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);\
+			abort();\
+		}\
+	} while(0)
+
+/* Trees are compared both ways: lept_is_equal ignores member order, the CBOR bytes do not. */
+static void fuzz_check_same_tree(const lept_value* expect, const lept_value* actual) {
+	size_t expect_length, actual_length;
+	char* e = lept_encode_cbor(expect, &expect_length);
+	char* a = lept_encode_cbor(actual, &actual_length);
+	FUZZ_CHECK(expect_length == actual_length && memcmp(e, a, expect_length) == 0);
+	FUZZ_CHECK(lept_is_equal(expect, actual));
+	FUZZ_CHECK(lept_hash(expect) == lept_hash(actual));
+	free(e);
+	free(a);
+}
+
+/* Any two values: equality is symmetric, and equal values hash alike. */
+static void fuzz_check_pair(const lept_value* a, const lept_value* b) {
+	int equal = lept_is_equal(a, b);
+	FUZZ_CHECK(lept_is_equal(b, a) == equal);
+	if (equal)
+		FUZZ_CHECK(lept_hash(a) == lept_hash(b));
+}
+
+static void fuzz_reverse_members(lept_value* v) {
+	size_t i, n;
+	if (lept_get_type(v) == LEPT_ARRAY) {
+		for (i = 0; i < lept_get_array_size(v); i++)
+			fuzz_reverse_members(lept_get_array_element(v, i));
+	}
+	else if (lept_get_type(v) == LEPT_OBJECT) {
+		for (i = 0, n = lept_get_object_size(v); i < n / 2; i++) {
+			lept_member m = v->u.o.m[i];
+			v->u.o.m[i] = v->u.o.m[n - 1 - i];
+			v->u.o.m[n - 1 - i] = m;
+		}
+		for (i = 0; i < n; i++)
+			fuzz_reverse_members(lept_get_object_value(v, i));
+	}
+}
+
+static int fuzz_has_duplicate_keys(const lept_value* v);
+
+/*
+ * Pairs drawn from one input: the elements of a root array against each other, and the
+ * tree against a copy with every object's members reversed, which is equal to it unless
+ * duplicate keys now pair up differently.
+ */
+static void fuzz_pairs(const lept_value* v) {
+	lept_value reversed;
+	size_t i, n;
+	if (lept_get_type(v) == LEPT_ARRAY) {
+		for (i = 1, n = lept_get_array_size(v); i < n; i++) {
+			fuzz_check_pair(lept_get_array_element(v, 0), lept_get_array_element(v, i));
+			fuzz_check_pair(lept_get_array_element(v, i - 1), lept_get_array_element(v, i));
+		}
+	}
+	lept_init(&reversed);
+	lept_copy(&reversed, v);
+	fuzz_reverse_members(&reversed);
+	fuzz_check_pair(v, &reversed);
+	if (!fuzz_has_duplicate_keys(v))
+		FUZZ_CHECK(lept_is_equal(v, &reversed));
+	lept_free(&reversed);
+}
+
+static void fuzz_check_reparse(const lept_value* expect, const char* json) {
+	lept_value v;
+	FUZZ_CHECK(lept_parse(&v, json) == LEPT_PARSE_OK);
+	fuzz_check_same_tree(expect, &v);
+	lept_free(&v);
+}
+
+static void fuzz_parse(const char* json) {
+	lept_value v;
+	if (lept_parse(&v, json) == LEPT_PARSE_OK)
+		lept_free(&v);
+}
+
+static void fuzz_parse_ex(const char* json, size_t length) {
+	lept_value v;
+	lept_parse_result r;
+	int ret = lept_parse_ex(&v, json, &r);
+	FUZZ_CHECK(r.code == ret);
+	if (ret == LEPT_PARSE_OK) {
+		FUZZ_CHECK(r.path == NULL);
+		lept_free(&v);
+		return;
+	}
+	FUZZ_CHECK(r.offset <= length && r.line >= 1 && r.column >= 1 && r.path != NULL);
+	lept_free_parse_result(&r);
+}
+
+static void fuzz_parallel(const char* json) {
+	lept_value serial, parallel;
+	lept_parse_result s, p;
+	int ret = lept_parse_ex(&serial, json, &s);
+	FUZZ_CHECK(lept_parse_parallel_ex(&parallel, json, 4, &p) == ret);
+	FUZZ_CHECK(s.code == p.code && s.offset == p.offset && s.line == p.line && s.column == p.column);
+	FUZZ_CHECK(s.path == NULL ? p.path == NULL : p.path != NULL && strcmp(s.path, p.path) == 0);
+	lept_free_parse_result(&s);
+	lept_free_parse_result(&p);
+	if (ret == LEPT_PARSE_OK) {
+		fuzz_check_same_tree(&serial, &parallel);
+		lept_free(&serial);
+		lept_free(&parallel);
+	}
+	else
+		FUZZ_CHECK(lept_get_type(&parallel) == LEPT_NULL);
+}
+
+static void fuzz_reformat(const char* json) {
+	lept_value v;
+	char* out;
+	size_t length;
+	int ret = lept_parse(&v, json);
+	FUZZ_CHECK(lept_validate(json) == ret);
+	FUZZ_CHECK(lept_minify(json, &out, &length) == ret);
+	if (ret == LEPT_PARSE_OK) {
+		FUZZ_CHECK(strlen(out) == length);
+		fuzz_check_reparse(&v, out);
+		free(out);
+	}
+	FUZZ_CHECK(lept_prettify(json, &out, &length) == ret);
+	if (ret == LEPT_PARSE_OK) {
+		fuzz_check_reparse(&v, out);
+		free(out);
+	}
+	/* transcoding straight from the text must give the bytes encoding the tree gives */
+	FUZZ_CHECK(lept_json_to_cbor(json, &out, &length) == ret);
+	if (ret == LEPT_PARSE_OK) {
+		size_t encoded_length;
+		char* encoded = lept_encode_cbor(&v, &encoded_length);
+		FUZZ_CHECK(encoded_length == length && memcmp(encoded, out, length) == 0);
+		free(encoded);
+		free(out);
+		lept_free(&v);
+	}
+}
+
+static void fuzz_cbor(const char* data, size_t length) {
+	lept_value v, w;
+	char *cbor, *json;
+	size_t cbor_length;
+	int ret = lept_decode_cbor(&v, data, length);
+	FUZZ_CHECK(lept_cbor_to_json(data, length, &json, NULL) == ret);
+	if (ret != LEPT_PARSE_OK)
+		return;
+	/* both decoders accept the same text, and the JSON written must parse back */
+	fuzz_check_reparse(&v, json);
+	/* re-encoding is canonical, so decoding it again must give the same tree */
+	cbor = lept_encode_cbor(&v, &cbor_length);
+	FUZZ_CHECK(lept_decode_cbor(&w, cbor, cbor_length) == LEPT_PARSE_OK);
+	fuzz_check_same_tree(&v, &w);
+	free(cbor);
+	free(json);
+	lept_free(&v);
+	lept_free(&w);
+}
+
+static void fuzz_cbor_roundtrip(const lept_value* v) {
+	lept_value w;
+	char *cbor, *json;
+	size_t cbor_length;
+	cbor = lept_encode_cbor(v, &cbor_length);
+	FUZZ_CHECK(lept_decode_cbor(&w, cbor, cbor_length) == LEPT_PARSE_OK);
+	fuzz_check_same_tree(v, &w);
+	FUZZ_CHECK(lept_cbor_to_json(cbor, cbor_length, &json, NULL) == LEPT_PARSE_OK);
+	fuzz_check_reparse(v, json);
+	free(cbor);
+	free(json);
+	lept_free(&w);
+}
+
+/* A JSON Pointer can only reach the first of several equal keys. */
+static int fuzz_has_duplicate_keys(const lept_value* v) {
+	size_t i;
+	if (lept_get_type(v) == LEPT_ARRAY) {
+		for (i = 0; i < lept_get_array_size(v); i++)
+			if (fuzz_has_duplicate_keys(lept_get_array_element(v, i)))
+				return 1;
+	}
+	else if (lept_get_type(v) == LEPT_OBJECT) {
+		for (i = 0; i < lept_get_object_size(v); i++)
+			if (lept_find_object_index(v, lept_get_object_key(v, i), lept_get_object_key_length(v, i)) != i
+				|| fuzz_has_duplicate_keys(lept_get_object_value(v, i)))
+				return 1;
+	}
+	return 0;
+}
+
+/* The key indices one patch keeps must give what a fresh start for every operation gives. */
+static int fuzz_patch_stepwise(const lept_value* doc, const lept_value* patch, const lept_value* whole, int whole_ret) {
+	lept_value stepwise, op;
+	size_t i;
+	int ret = LEPT_PATCH_OK;
+	lept_init(&stepwise);
+	lept_copy(&stepwise, doc);
+	if (lept_get_type(patch) != LEPT_ARRAY)
+		ret = lept_apply_patch(&stepwise, patch);
+	for (i = 0; ret == LEPT_PATCH_OK && lept_get_type(patch) == LEPT_ARRAY && i < lept_get_array_size(patch); i++) {
+		lept_init(&op);
+		lept_set_array(&op, 1);
+		lept_copy(lept_pushback_array_element(&op), lept_get_array_element(patch, i));
+		ret = lept_apply_patch(&stepwise, &op);
+		lept_free(&op);
+	}
+	FUZZ_CHECK(ret == whole_ret);
+	fuzz_check_same_tree(&stepwise, whole);
+	lept_free(&stepwise);
+	return ret;
+}
+
+static void fuzz_patch(const char* json) {
+	lept_value v, patch, diff;
+	if (lept_parse(&v, json) != LEPT_PARSE_OK)
+		return;
+	if (lept_get_type(&v) == LEPT_ARRAY && lept_get_array_size(&v) == 2) {
+		lept_value* doc = lept_get_array_element(&v, 0);
+		lept_value target;
+		int ret;
+		lept_init(&target);
+		lept_copy(&target, doc);
+		ret = lept_apply_patch(&target, lept_get_array_element(&v, 1));
+		fuzz_patch_stepwise(doc, lept_get_array_element(&v, 1), &target, ret);
+		if (ret == LEPT_PATCH_OK
+			&& !fuzz_has_duplicate_keys(doc) && !fuzz_has_duplicate_keys(&target)) {
+			/* whatever the patch did, the diff between the two must recreate it */
+			lept_init(&patch);
+			lept_diff(doc, &target, &patch);
+			FUZZ_CHECK(lept_apply_patch(doc, &patch) == LEPT_PATCH_OK);
+			FUZZ_CHECK(lept_is_equal(doc, &target));
+			lept_free(&patch);
+		}
+		lept_free(&target);
+	}
+	lept_init(&diff);
+	lept_diff(&v, &v, &diff);
+	FUZZ_CHECK(lept_get_array_size(&diff) == 0);
+	lept_free(&diff);
+	lept_free(&v);
+}
+
+static void fuzz_diff(const char* json, size_t length) {
+	lept_value v, copy;
+	lept_document* doc;
+	int ret;
+	fuzz_parse_ex(json, length);
+	fuzz_parallel(json);
+	fuzz_reformat(json);
+	fuzz_patch(json);
+	ret = lept_parse(&v, json);
+	FUZZ_CHECK(lept_document_parse(&doc, json) == ret);
+	if (ret != LEPT_PARSE_OK)
+		return;
+	fuzz_check_same_tree(&v, lept_document_get_root(doc));
+	lept_document_release(doc);
+	lept_init(&copy);
+	lept_copy(&copy, &v);
+	fuzz_check_same_tree(&v, &copy);
+	fuzz_pairs(&v);
+	fuzz_cbor_roundtrip(&v);
+	lept_free(&copy);
+	lept_free(&v);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size) {
+	/* the parser reads up to a '\0', so the input gets one */
+	char* json = (char*)malloc(size + 1);
+	memcpy(json, data, size);
+	json[size] = '\0';
+	switch (LEPT_FUZZ_TARGET) {
+	case LEPT_FUZZ_PARSE:    fuzz_parse(json); break;
+	case LEPT_FUZZ_PARSE_EX: fuzz_parse_ex(json, size); break;
+	case LEPT_FUZZ_PARALLEL: fuzz_parallel(json); break;
+	case LEPT_FUZZ_REFORMAT: fuzz_reformat(json); break;
+	case LEPT_FUZZ_CBOR:     fuzz_cbor(json, size); break;
+	case LEPT_FUZZ_PATCH:    fuzz_patch(json); break;
+	default:                 fuzz_diff(json, strlen(json)); break;
+	}
+	free(json);
+	return 0;
+}
+
+#ifdef LEPT_FUZZ_STANDALONE
+#include <chrono>
+#include <string>
+
+#ifndef LEPT_FUZZ_RANDOM_RUNS
+#define LEPT_FUZZ_RANDOM_RUNS 20000
+#endif
+
+/* Growing the input 4x, in any of the ways below, must not cost much more than 4x the time. */
+#define LEPT_FUZZ_GROWTH       4
+#define LEPT_FUZZ_MAX_SLOWDOWN 10.0
+#define LEPT_FUZZ_SCALED_SIZE  (64 * 1024)
+/* the parser recurses once per level, so nesting grows from a depth that fits the stack */
+#define LEPT_FUZZ_SCALED_DEPTH 1024
+/* One random input in this many also gets the timing check, which is slow. */
+#define LEPT_FUZZ_LINEAR_SAMPLE 256
+
+static unsigned int fuzz_seed = 2463534242u;
+
+static unsigned int fuzz_rand() {
+	fuzz_seed ^= fuzz_seed << 13;
+	fuzz_seed ^= fuzz_seed >> 17;
+	fuzz_seed ^= fuzz_seed << 5;
+	return fuzz_seed;
+}
+
+static void fuzz_generate(std::string& s, int depth) {
+	static const char* scalars[] = {
+		"null", "true", "false", "0", "-0", "1.5", "-1e-10", "1E+400", "123456789012345678901",
+		"\"\"", "\"a\"", "\"\\n\\t\\\\\\\"\"", "\"\\/~\"", "\"a/b\"", "\"~0\""
+	};
+	static const char* whitespace[] = { "", "", " ", "\n", "\t ", "\r\n" };
+	size_t i, n;
+	switch (depth > 6 ? 0 : fuzz_rand() % 4) {
+	case 1:
+		s += '[';
+		for (i = 0, n = fuzz_rand() % 5; i < n; i++) {
+			s += i ? "," : "";
+			s += whitespace[fuzz_rand() % 6];
+			fuzz_generate(s, depth + 1);
+		}
+		s += ']';
+		break;
+	case 2:
+		s += '{';
+		for (i = 0, n = fuzz_rand() % 5; i < n; i++) {
+			s += i ? "," : "";
+			s += '"';
+			s += (char)('a' + fuzz_rand() % 4);
+			s += "\":";
+			s += whitespace[fuzz_rand() % 6];
+			fuzz_generate(s, depth + 1);
+		}
+		s += '}';
+		break;
+	default:
+		s += scalars[fuzz_rand() % (sizeof(scalars) / sizeof(scalars[0]))];
+	}
+	s += whitespace[fuzz_rand() % 6];
+}
+
+/* [document, patch] pairs for the patch target, with paths likely to hit something */
+static void fuzz_generate_patch(std::string& s) {
+	static const char* ops[] = { "add", "remove", "replace", "move", "copy", "test" };
+	static const char* paths[] = { "", "/a", "/b", "/a/0", "/b/1", "/a/-", "/c/a", "/0", "/1/b", "/e", "/h", "/i", "/d/e", "/j/b" };
+	static const size_t path_count = sizeof(paths) / sizeof(paths[0]);
+	size_t i, n;
+	s += '[';
+	if (fuzz_rand() % 2 == 0)
+		fuzz_generate(s, 2);
+	else {
+		/* wide enough for the patch to index it */
+		s += '{';
+		for (i = 0, n = 6 + fuzz_rand() % 6; i < n; i++) {
+			s += i ? ",\"" : "\"";
+			s += (char)('a' + fuzz_rand() % 10);
+			s += "\":";
+			fuzz_generate(s, 3);
+		}
+		s += '}';
+	}
+	s += ",[";
+	for (i = 0, n = fuzz_rand() % 8 + 1; i < n; i++) {
+		s += i ? "," : "";
+		s += "{\"op\":\"";
+		s += ops[fuzz_rand() % 6];
+		s += "\",\"path\":\"";
+		s += paths[fuzz_rand() % path_count];
+		s += "\",\"from\":\"";
+		s += paths[fuzz_rand() % path_count];
+		s += "\",\"value\":";
+		fuzz_generate(s, 4);
+		s += '}';
+	}
+	s += "]]";
+}
+
+/* Small flat objects over two keys and two values, so that pairs often collide. */
+static void fuzz_generate_pair(std::string& s) {
+	size_t i, j, n;
+	s += '[';
+	for (i = 0; i < 2; i++) {
+		s += i ? ",{" : "{";
+		for (j = 0, n = fuzz_rand() % 5; j < n; j++) {
+			s += j ? "," : "";
+			s += fuzz_rand() % 2 ? "\"a\":" : "\"b\":";
+			s += fuzz_rand() % 2 ? "0" : "1";
+		}
+		s += '}';
+	}
+	s += ']';
+}
+
+/* Mostly valid documents, a share of them with one byte changed, dropped or cut. */
+static void fuzz_random_input(std::string& s) {
+	static const char bytes[] = "[]{},:\"\\ 0-.eE\x01";
+	s.clear();
+	if (fuzz_rand() % 4 == 0)
+		fuzz_generate_patch(s);
+	else if (fuzz_rand() % 4 == 0)
+		fuzz_generate_pair(s);
+	else
+		fuzz_generate(s, 0);
+	if (!s.empty() && fuzz_rand() % 2) {
+		size_t at = fuzz_rand() % s.size();
+		switch (fuzz_rand() % 3) {
+		case 0: s[at] = bytes[fuzz_rand() % (sizeof(bytes) - 1)]; break;
+		case 1: s.erase(at, 1); break;
+		default: s.resize(at); break;
+		}
+	}
+}
+
+static double fuzz_parse_seconds(const std::string& json) {
+	double best = 1e30;
+	int i;
+	for (i = 0; i < 3; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		fuzz_parse(json.c_str());
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+static void fuzz_write_string(std::string& s, const char* str, size_t len, size_t repeat) {
+	char escaped[8];
+	size_t i, r;
+	s += '"';
+	for (r = 0; r < repeat; r++)
+		for (i = 0; i < len; i++) {
+			unsigned char ch = (unsigned char)str[i];
+			if (ch == '"' || ch == '\\')
+				s += '\\';
+			if (ch < 0x20) {
+				snprintf(escaped, sizeof(escaped), "\\u%04X", ch);
+				s += escaped;
+			}
+			else
+				s += (char)ch;
+		}
+	s += '"';
+}
+
+/* Writes v back as JSON, with the members or the characters of target repeated n times. */
+static void fuzz_write_grown(std::string& s, const lept_value* v, const lept_value* target, size_t n) {
+	char number[32];
+	size_t i, r, repeat = v == target ? n : 1;
+	switch (lept_get_type(v)) {
+	case LEPT_NULL:  s += "null"; break;
+	case LEPT_FALSE: s += "false"; break;
+	case LEPT_TRUE:  s += "true"; break;
+	case LEPT_NUMBER:
+		snprintf(number, sizeof(number), "%.17g", lept_get_number(v));
+		s += number;
+		break;
+	case LEPT_STRING:
+		fuzz_write_string(s, lept_get_string(v), lept_get_string_length(v), repeat);
+		break;
+	case LEPT_ARRAY:
+		s += '[';
+		for (r = 0; r < repeat; r++)
+			for (i = 0; i < lept_get_array_size(v); i++) {
+				s += r || i ? "," : "";
+				fuzz_write_grown(s, lept_get_array_element(v, i), target, n);
+			}
+		s += ']';
+		break;
+	case LEPT_OBJECT:
+		s += '{';
+		for (r = 0; r < repeat; r++)
+			for (i = 0; i < lept_get_object_size(v); i++) {
+				s += r || i ? "," : "";
+				fuzz_write_string(s, lept_get_object_key(v, i), lept_get_object_key_length(v, i), 1);
+				s += ':';
+				fuzz_write_grown(s, lept_get_object_value(v, i), target, n);
+			}
+		s += '}';
+		break;
+	}
+}
+
+/* The container with the most members, or the longest string, anywhere in v. */
+static void fuzz_find_largest(const lept_value* v, int strings, const lept_value** largest, size_t* size) {
+	size_t i, n = 0;
+	switch (lept_get_type(v)) {
+	case LEPT_STRING:
+		n = strings ? lept_get_string_length(v) : 0;
+		break;
+	case LEPT_ARRAY:
+		n = strings ? 0 : lept_get_array_size(v);
+		for (i = 0; i < lept_get_array_size(v); i++)
+			fuzz_find_largest(lept_get_array_element(v, i), strings, largest, size);
+		break;
+	case LEPT_OBJECT:
+		n = strings ? 0 : lept_get_object_size(v);
+		for (i = 0; i < lept_get_object_size(v); i++)
+			fuzz_find_largest(lept_get_object_value(v, i), strings, largest, size);
+		break;
+	default:
+		break;
+	}
+	if (n > *size) {
+		*largest = v;
+		*size = n;
+	}
+}
+
+/* Each growth writes json scaled up by scale into out, or returns 0 if json has nothing to grow that way. */
+typedef int (*fuzz_growth)(std::string& out, const std::string& json, const lept_value* v, size_t scale);
+
+/* copies of the input side by side in an array */
+static int fuzz_grow_repeat(std::string& out, const std::string& json, const lept_value* v, size_t scale) {
+	size_t i, copies = (LEPT_FUZZ_SCALED_SIZE / json.size() + 1) * scale;
+	out = "[";
+	for (i = 0; i < copies; i++)
+		out += (i ? "," : "") + json;
+	out += "]";
+	return 1;
+}
+
+/* the input at the bottom of arrays and objects nested in turn */
+static int fuzz_grow_nest(std::string& out, const std::string& json, const lept_value* v, size_t scale) {
+	size_t i, depth = LEPT_FUZZ_SCALED_DEPTH * scale;
+	out.clear();
+	for (i = 0; i < depth; i++)
+		out += i % 2 ? "{\"a\":" : "[";
+	out += json;
+	for (i = depth; i-- > 0; )
+		out += i % 2 ? "}" : "]";
+	return 1;
+}
+
+/* the members of the input's largest container repeated in place */
+static int fuzz_grow_widen(std::string& out, const std::string& json, const lept_value* v, size_t scale) {
+	const lept_value* largest = NULL;
+	size_t size = 0;
+	fuzz_find_largest(v, 0, &largest, &size);
+	if (largest == NULL)
+		return 0;
+	out.clear();
+	fuzz_write_grown(out, v, largest, (LEPT_FUZZ_SCALED_SIZE / json.size() + 1) * scale);
+	return 1;
+}
+
+/* the characters of the input's longest string repeated in place */
+static int fuzz_grow_lengthen(std::string& out, const std::string& json, const lept_value* v, size_t scale) {
+	const lept_value* largest = NULL;
+	size_t size = 0;
+	fuzz_find_largest(v, 1, &largest, &size);
+	if (largest == NULL)
+		return 0;
+	out.clear();
+	fuzz_write_grown(out, v, largest, (LEPT_FUZZ_SCALED_SIZE / size + 1) * scale);
+	return 1;
+}
+
+static struct {
+	const char* name;
+	fuzz_growth grow;
+	double worst_ratio; /* over the inputs that took long enough to time */
+} fuzz_growths[] = {
+	{ "repeat",   fuzz_grow_repeat,   0.0 },
+	{ "nest",     fuzz_grow_nest,     0.0 },
+	{ "widen",    fuzz_grow_widen,    0.0 },
+	{ "lengthen", fuzz_grow_lengthen, 0.0 }
+};
+
+#define LEPT_FUZZ_GROWTH_COUNT (sizeof(fuzz_growths) / sizeof(fuzz_growths[0]))
+
+/* Grows a valid input in every way above, then four times as far, and compares the parse times. */
+static int fuzz_check_linear(const std::string& json, const char* name) {
+	std::string small, large;
+	size_t k;
+	double t_small, t_large;
+	int ret = 0;
+	lept_value v;
+	if (json.empty() || lept_parse(&v, json.c_str()) != LEPT_PARSE_OK)
+		return 0;
+	for (k = 0; k < LEPT_FUZZ_GROWTH_COUNT; k++) {
+		if (!fuzz_growths[k].grow(small, json, &v, 1))
+			continue;
+		fuzz_growths[k].grow(large, json, &v, LEPT_FUZZ_GROWTH);
+		t_small = fuzz_parse_seconds(small);
+		t_large = fuzz_parse_seconds(large);
+		if (t_large <= 1e-3)
+			continue;
+		if (t_large > fuzz_growths[k].worst_ratio * t_small)
+			fuzz_growths[k].worst_ratio = t_large / t_small;
+		if (t_large > LEPT_FUZZ_MAX_SLOWDOWN * t_small) {
+			fprintf(stderr, "%s: parse time grows super-linearly under %s (%.3f ms -> %.3f ms, %.1fx, for %dx the input)\n",
+				name, fuzz_growths[k].name, t_small * 1e3, t_large * 1e3, t_large / t_small, LEPT_FUZZ_GROWTH);
+			ret = 1;
+		}
+	}
+	lept_free(&v);
+	return ret;
+}
+
+static void fuzz_report_linear() {
+	size_t k;
+	printf("worst parse time ratio for %dx the input:", LEPT_FUZZ_GROWTH);
+	for (k = 0; k < LEPT_FUZZ_GROWTH_COUNT; k++) {
+		if (fuzz_growths[k].worst_ratio > 0.0)
+			printf(" %s %.1fx", fuzz_growths[k].name, fuzz_growths[k].worst_ratio);
+		else
+			printf(" %s -", fuzz_growths[k].name);
+	}
+	printf("\n");
+}
+
+static int fuzz_file(const char* path) {
+	std::string json;
+	char buffer[4096];
+	size_t n;
+	FILE* fp = fopen(path, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: cannot open\n", path);
+		return 1;
+	}
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		json.append(buffer, n);
+	fclose(fp);
+	LLVMFuzzerTestOneInput((const unsigned char*)json.data(), json.size());
+	return LEPT_FUZZ_TARGET == LEPT_FUZZ_DIFF ? fuzz_check_linear(json, path) : 0;
+}
+
+int main(int argc, char* argv[]) {
+	std::string json;
+	int i, ret = 0;
+	if (argc > 1) {
+		for (i = 1; i < argc; i++)
+			ret |= fuzz_file(argv[i]);
+		printf("%d inputs checked\n", argc - 1);
+		if (LEPT_FUZZ_TARGET == LEPT_FUZZ_DIFF)
+			fuzz_report_linear();
+		return ret;
+	}
+	for (i = 0; i < LEPT_FUZZ_RANDOM_RUNS; i++) {
+		fuzz_random_input(json);
+		LLVMFuzzerTestOneInput((const unsigned char*)json.data(), json.size());
+		if (LEPT_FUZZ_TARGET == LEPT_FUZZ_DIFF && i % LEPT_FUZZ_LINEAR_SAMPLE == 0)
+			ret |= fuzz_check_linear(json, "random input");
+	}
+	printf("%d random inputs checked\n", LEPT_FUZZ_RANDOM_RUNS);
+	if (LEPT_FUZZ_TARGET == LEPT_FUZZ_DIFF)
+		fuzz_report_linear();
+	return ret;
+}
+#endif
@@ -6,7 +6,16 @@
 
 #define _CRTDBG_MAP_ALLOC
 #include <stdlib.h>
+#ifdef _MSC_VER
 #include <crtdbg.h> 
+#endif
+#include <string.h>  /* memcpy, memcmp */
+#include <stdint.h>  /* uint8_t, uint64_t */
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
 void lept_parse_whitespace(lept_context* c)
 {
@@ -22,8 +31,10 @@ int lept_parse_literal(lept_context* c, lept_value* v, const char* literal, lept
 	size_t i;
 	EXPECT(c, literal[0]);
 	for (i = 0; literal[i + 1]; i++)
-		if (c->json[i] != literal[i + 1])
+		if (c->json[i] != literal[i + 1]) {
+			c->json += i;
 			return LEPT_PARSE_INVALID_VALUE;
+		}
 	c->json += i;
 	v->type = type;
 	return LEPT_PARSE_OK;
@@ -43,18 +54,18 @@ int lept_parse_number(lept_context* c, lept_value* v) {
 		p++;
 	}
 	else {
-		if (!ISDIGIT1TO9(*p)) return LEPT_PARSE_INVALID_VALUE;
+		if (!ISDIGIT1TO9(*p)) { c->json = p; return LEPT_PARSE_INVALID_VALUE; }
 		for (p++; ISDIGIT(*p); p++);
 	}
 	if (*p == '.') {
 		p++;
-		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+		if (!ISDIGIT(*p)) { c->json = p; return LEPT_PARSE_INVALID_VALUE; }
 		for (p++; ISDIGIT(*p); p++);
 	}
 	if (*p == 'e' || *p == 'E') {
 		p++;
 		if (*p == '+' || *p == '-') p++;
-		if (!ISDIGIT(*p)) return LEPT_PARSE_INVALID_VALUE;
+		if (!ISDIGIT(*p)) { c->json = p; return LEPT_PARSE_INVALID_VALUE; }
 		for (p++; ISDIGIT(*p); p++);
 	}
 
@@ -122,6 +133,42 @@ void* lept_context_pop(lept_context* c, size_t size) {
 
 #define PUTC(c, ch) do { *(char*)lept_context_push(c, sizeof(char)) = (ch); } while(0)
 
+/*
+ * The JSON Pointer of a failure is assembled while the error unwinds, each
+ * container prepending its own index or key, so a successful parse never
+ * touches it.
+ */
+void lept_path_prepend(lept_context* c, const char* s, size_t len) {
+	size_t i, n = len + 1;
+	char* p;
+	for (i = 0; i < len; i++)
+		if (s[i] == '~' || s[i] == '/')
+			n++;
+	c->path = (char*)realloc(c->path, c->path_len + n + 1);
+	memmove(c->path + n, c->path, c->path_len);
+	p = c->path;
+	*p++ = '/';
+	for (i = 0; i < len; i++) {
+		switch (s[i]) {
+		case '~': *p++ = '~'; *p++ = '0'; break;
+		case '/': *p++ = '~'; *p++ = '1'; break;
+		default:  *p++ = s[i];
+		}
+	}
+	c->path_len += n;
+	c->path[c->path_len] = '\0';
+}
+
+void lept_path_prepend_index(lept_context* c, size_t index) {
+	char buffer[24];
+	char* p = buffer + sizeof(buffer);
+	do {
+		*--p = (char)('0' + index % 10);
+		index /= 10;
+	} while (index > 0);
+	lept_path_prepend(c, p, buffer + sizeof(buffer) - p);
+}
+
 int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
 	size_t head = c->top;
 	const char* p;
@@ -137,6 +184,7 @@ int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
 			return LEPT_PARSE_OK;
 		case '\0':
 			c->top = head;
+			c->json = p - 1;
 			return LEPT_PARSE_MISS_QUOTATION_MARK;
 		case '\\':
 			switch (*p++) {
@@ -150,12 +198,14 @@ int lept_parse_string_raw(lept_context* c, char** str, size_t* len) {
 			case 't':  PUTC(c, '\t'); break;
 			default:
 				c->top = head;
+				c->json = p - 2;
 				return LEPT_PARSE_INVALID_STRING_ESCAPE;
 			}
 			break;
 		default:
 			if ((unsigned char)ch < 0x20) {
 				c->top = head;
+				c->json = p - 1;
 				return LEPT_PARSE_INVALID_STRING_CHAR;
 			}
 			PUTC(c, ch);
@@ -184,7 +234,7 @@ int lept_parse_array(lept_context* c, lept_value* v) {
 	lept_parse_whitespace(c);
 	if (*c->json == ']') {
 		v->type = LEPT_ARRAY;
-		v->u.a.size = 0;
+		v->u.a.size = v->u.a.capacity = 0;
 		v->u.a.e = NULL;
 		c->json++;
 		return LEPT_PARSE_OK;
@@ -196,6 +246,7 @@ int lept_parse_array(lept_context* c, lept_value* v) {
 		lept_init(&e);
 		lept_parse_whitespace(c);
 		if ((ret = lept_parse_value(c, &e)) != LEPT_PARSE_OK) {
+			lept_path_prepend_index(c, size);
 			for (int i = 0; i < size; i++)
 			{
 				lept_free((lept_value*)lept_context_pop(c, sizeof(lept_value)));
@@ -213,7 +264,7 @@ int lept_parse_array(lept_context* c, lept_value* v) {
 		{
 			c->json++;
 			v->type = LEPT_ARRAY;
-			v->u.a.size = size;
+			v->u.a.size = v->u.a.capacity = size;
 			size *= sizeof(lept_value);
 			memcpy(v->u.a.e = (lept_value*)malloc(size), lept_context_pop(c, size), size);
 			return LEPT_PARSE_OK;
@@ -240,7 +291,7 @@ int lept_parse_object(lept_context* c, lept_value* v) {
 	if (*(c->json) == '}') {
 		v->type = LEPT_OBJECT;
 		v->u.o.m = 0;//ָҲҪʼ
-		v->u.o.size = 0;
+		v->u.o.size = v->u.o.capacity = 0;
 		c->json++;
 		return LEPT_PARSE_OK;
 	}
@@ -261,7 +312,9 @@ int lept_parse_object(lept_context* c, lept_value* v) {
 
 		//m.klen = len;
 		//m.k = str;  Ȼָͬ,m.kֵmallocϵкģûfree
-		memcpy(m.k = (char*)malloc(m.klen + 1), str, m.klen);
+		m.k = (char*)malloc(m.klen + 1);
+		if (m.klen > 0) /* an empty key may come from a stack that was never allocated */
+			memcpy(m.k, str, m.klen);
 		m.k[m.klen] = '\0';
 
 		lept_parse_whitespace(c);
@@ -272,8 +325,10 @@ int lept_parse_object(lept_context* c, lept_value* v) {
 		c->json++;
 		lept_parse_whitespace(c);
 
-		if ((ret = lept_parse_value(c, &m.v)) != LEPT_PARSE_OK)
+		if ((ret = lept_parse_value(c, &m.v)) != LEPT_PARSE_OK) {
+			lept_path_prepend(c, m.k, m.klen);
 			break;
+		}
 		memcpy(lept_context_push(c, sizeof(lept_member)), &m, sizeof(lept_member));
 		size++;
 		m.k = NULL;
@@ -286,7 +341,7 @@ int lept_parse_object(lept_context* c, lept_value* v) {
 		else if (*(c->json) == '}') {
 			c->json++;
 			v->type = LEPT_OBJECT;
-			v->u.o.size = size;
+			v->u.o.size = v->u.o.capacity = size;
 			size_t s = size * sizeof(lept_member);
 			memcpy(v->u.o.m = (lept_member*)malloc(s), lept_context_pop(c, s), s);
 			return LEPT_PARSE_OK;
@@ -323,12 +378,19 @@ int lept_parse_value(lept_context* c, lept_value* v) {
 }
 
 int lept_parse(lept_value* v, const char* json)
+{
+	return lept_parse_ex(v, json, NULL);
+}
+
+int lept_parse_ex(lept_value* v, const char* json, lept_parse_result* result)
 {
 	lept_context c;
 	assert(v != NULL);
 	c.json = json;
 	c.stack = NULL;
 	c.size = c.top = 0;
+	c.path = NULL;
+	c.path_len = 0;
 	lept_init(v);
 
 	lept_parse_whitespace(&c);
@@ -338,14 +400,230 @@ int lept_parse(lept_value* v, const char* json)
 		lept_parse_whitespace(&c);
 		if (*c.json != '\0')
 		{
-			v->type = LEPT_NULL;
+			lept_free(v);
 			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
 		}
 	}
 	assert(c.top == 0);    /* <- */
 	free(c.stack);         /* <- */
+	if (result != NULL) {
+		result->code = ret;
+		result->offset = result->line = result->column = 0;
+		result->path = NULL;
+		if (ret != LEPT_PARSE_OK) {
+			const char* p;
+			result->offset = c.json - json;
+			result->line = result->column = 1;
+			for (p = json; p < c.json; p++) {
+				if (*p == '\n') {
+					result->line++;
+					result->column = 1;
+				}
+				else
+					result->column++;
+			}
+			result->path = c.path != NULL ? c.path : (char*)calloc(1, 1);
+			c.path = NULL;
+		}
+	}
+	free(c.path);
 	return ret;
 }
+
+void lept_free_parse_result(lept_parse_result* result) {
+	assert(result != NULL);
+	free(result->path);
+	result->path = NULL;
+}
+/*----------------------parallel parse--------------------------*/
+/*
+ * A structural pass records where every top-level ',' is, so the element
+ * count is known up front and each thread parses a disjoint run of elements
+ * straight into its final slot. Anything the pass cannot vouch for, and any
+ * error a thread hits, is handed back to lept_parse so that error codes are
+ * exactly those of the serial parser.
+ */
+struct lept_parallel_task
+{
+	const char** delims; /* delims[i] and delims[i + 1] bracket element i */
+	lept_value* v;
+	size_t begin, end, done;
+	int ret;
+};
+
+/* Pushes the opening bracket, each top-level comma and the closing bracket. */
+int lept_parallel_scan(lept_context* c) {
+	const char* p = c->json;
+	size_t depth = 0;
+	*(const char**)lept_context_push(c, sizeof(const char*)) = p++;
+	for (;; p++) {
+		switch (*p) {
+		case '\0':
+			return 0;
+		case '"':
+			for (p++; *p != '"'; p++) {
+				if (*p == '\0')
+					return 0;
+				if (*p == '\\' && *++p == '\0')
+					return 0;
+			}
+			break;
+		case '[':
+		case '{':
+			depth++;
+			break;
+		case ']':
+		case '}':
+			if (depth-- == 0) {
+				*(const char**)lept_context_push(c, sizeof(const char*)) = p;
+				c->json = p + 1;
+				return 1;
+			}
+			break;
+		case ',':
+			if (depth == 0)
+				*(const char**)lept_context_push(c, sizeof(const char*)) = p;
+			break;
+		}
+	}
+}
+
+int lept_parallel_parse_member(lept_context* c, lept_member* m) {
+	char* str;
+	if (*c->json != '"' || lept_parse_string_raw(c, &str, &m->klen) != LEPT_PARSE_OK)
+		return LEPT_PARSE_MISS_KEY;
+	m->k = (char*)malloc(m->klen + 1);
+	if (m->klen > 0)
+		memcpy(m->k, str, m->klen);
+	m->k[m->klen] = '\0';
+	lept_parse_whitespace(c);
+	if (*c->json != ':')
+		return LEPT_PARSE_MISS_COLON;
+	c->json++;
+	lept_parse_whitespace(c);
+	return lept_parse_value(c, &m->v);
+}
+
+void lept_parallel_parse_range(lept_parallel_task* t) {
+	lept_context c;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	c.path = NULL;
+	c.path_len = 0;
+	t->ret = LEPT_PARSE_OK;
+	for (t->done = t->begin; t->done < t->end; t->done++) {
+		c.json = t->delims[t->done] + 1;
+		lept_parse_whitespace(&c);
+		if (t->v->type == LEPT_ARRAY) {
+			lept_value* e = &t->v->u.a.e[t->done];
+			lept_init(e);
+			t->ret = lept_parse_value(&c, e);
+		}
+		else {
+			lept_member* m = &t->v->u.o.m[t->done];
+			m->k = NULL;
+			lept_init(&m->v);
+			if ((t->ret = lept_parallel_parse_member(&c, m)) != LEPT_PARSE_OK)
+				free(m->k);
+		}
+		if (t->ret == LEPT_PARSE_OK) {
+			lept_parse_whitespace(&c);
+			if (c.json != t->delims[t->done + 1])
+				t->ret = LEPT_PARSE_INVALID_VALUE;
+			else
+				continue;
+			t->done++; /* the element itself was parsed, keep it for cleanup */
+		}
+		break;
+	}
+	free(c.stack);
+	free(c.path);
+}
+
+int lept_parse_parallel(lept_value* v, const char* json, unsigned int threads) {
+	return lept_parse_parallel_ex(v, json, threads, NULL);
+}
+
+/* Any failure is parsed again serially, so the result is the one lept_parse_ex reports. */
+int lept_parse_parallel_ex(lept_value* v, const char* json, unsigned int threads, lept_parse_result* result) {
+	lept_context c;
+	std::vector<lept_parallel_task> tasks;
+	std::vector<std::thread> pool;
+	const char** delims;
+	size_t i, j, count;
+	int ret = LEPT_PARSE_OK;
+	assert(v != NULL && json != NULL);
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	lept_init(v);
+	c.json = json;
+	c.stack = NULL;
+	c.size = c.top = 0;
+	lept_parse_whitespace(&c);
+	if (threads <= 1 || (*c.json != '[' && *c.json != '{') || !lept_parallel_scan(&c)) {
+		free(c.stack);
+		return lept_parse_ex(v, json, result);
+	}
+	lept_parse_whitespace(&c);
+	delims = (const char**)c.stack;
+	count = c.top / sizeof(const char*) - 1;
+	if (*c.json != '\0' || *delims[count] != (*delims[0] == '[' ? ']' : '}') || count < threads) {
+		free(c.stack);
+		return lept_parse_ex(v, json, result);
+	}
+
+	if (*delims[0] == '[') {
+		lept_set_array(v, count);
+		v->u.a.size = count;
+	}
+	else {
+		lept_set_object(v, count);
+		v->u.o.size = count;
+	}
+	tasks.resize(threads);
+	for (i = 0; i < threads; i++) {
+		tasks[i].delims = delims;
+		tasks[i].v = v;
+		tasks[i].begin = count * i / threads;
+		tasks[i].end = count * (i + 1) / threads;
+		tasks[i].done = tasks[i].begin;
+	}
+	for (i = 1; i < threads; i++)
+		pool.push_back(std::thread(lept_parallel_parse_range, &tasks[i]));
+	lept_parallel_parse_range(&tasks[0]);
+	for (i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	for (i = 0; i < threads; i++)
+		if (tasks[i].ret != LEPT_PARSE_OK)
+			ret = tasks[i].ret;
+	free(c.stack);
+	if (ret == LEPT_PARSE_OK) {
+		if (result != NULL) {
+			result->code = LEPT_PARSE_OK;
+			result->offset = result->line = result->column = 0;
+			result->path = NULL;
+		}
+		return LEPT_PARSE_OK;
+	}
+
+	for (i = 0; i < threads; i++) {
+		for (j = tasks[i].begin; j < tasks[i].done; j++) {
+			if (v->type == LEPT_ARRAY)
+				lept_free(&v->u.a.e[j]);
+			else {
+				free(v->u.o.m[j].k);
+				lept_free(&v->u.o.m[j].v);
+			}
+		}
+	}
+	if (v->type == LEPT_ARRAY)
+		v->u.a.size = 0;
+	else
+		v->u.o.size = 0;
+	lept_free(v);
+	return lept_parse_ex(v, json, result);
+}
 /*--------------------------------------------------------*/
 
 lept_type lept_get_type(const lept_value* v)
@@ -388,27 +666,148 @@ void lept_set_string(lept_value* v, const char* s, size_t len) {
 	assert(v != NULL && (s != NULL || len == 0));
 	lept_free(v);
 	v->u.s.s = (char *)malloc(len + 1);
-	memcpy(v->u.s.s, s, len);
+	if (len > 0)
+		memcpy(v->u.s.s, s, len);
 	v->u.s.s[len] = '\0';
 	v->u.s.len = len;
 	v->type = LEPT_STRING;
 }
 
+void lept_set_array(lept_value* v, size_t capacity) {
+	assert(v != NULL);
+	lept_free(v);
+	v->type = LEPT_ARRAY;
+	v->u.a.size = 0;
+	v->u.a.capacity = capacity;
+	v->u.a.e = capacity > 0 ? (lept_value*)malloc(capacity * sizeof(lept_value)) : NULL;
+}
+
 size_t lept_get_array_size(const lept_value* v) {
 	assert(v != NULL&&v->type == LEPT_ARRAY);
 	return v->u.a.size;
 }
 
+size_t lept_get_array_capacity(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	return v->u.a.capacity;
+}
+
+void lept_reserve_array(lept_value* v, size_t capacity) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->u.a.capacity < capacity) {
+		v->u.a.capacity = capacity;
+		v->u.a.e = (lept_value*)realloc(v->u.a.e, capacity * sizeof(lept_value));
+	}
+}
+
+void lept_shrink_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->u.a.capacity > v->u.a.size) {
+		v->u.a.capacity = v->u.a.size;
+		if (v->u.a.size == 0) {
+			free(v->u.a.e);
+			v->u.a.e = NULL;
+		}
+		else
+			v->u.a.e = (lept_value*)realloc(v->u.a.e, v->u.a.size * sizeof(lept_value));
+	}
+}
+
+void lept_clear_array(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	lept_erase_array_element(v, 0, v->u.a.size);
+}
+
 lept_value* lept_get_array_element(const lept_value* v, size_t index) {
 	assert(v != NULL && v->type == LEPT_ARRAY);
 	assert(index < v->u.a.size);
 	return &v->u.a.e[index];
 }
 
+/* Doubling keeps a run of n pushbacks at O(n) element moves in total. */
+lept_value* lept_pushback_array_element(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY);
+	if (v->u.a.size == v->u.a.capacity)
+		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+	lept_init(&v->u.a.e[v->u.a.size]);
+	return &v->u.a.e[v->u.a.size++];
+}
+
+void lept_popback_array_element(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_ARRAY && v->u.a.size > 0);
+	lept_free(&v->u.a.e[--v->u.a.size]);
+}
+
+lept_value* lept_insert_array_element(lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_ARRAY && index <= v->u.a.size);
+	if (v->u.a.size == v->u.a.capacity)
+		lept_reserve_array(v, v->u.a.capacity == 0 ? 1 : v->u.a.capacity * 2);
+	memmove(&v->u.a.e[index + 1], &v->u.a.e[index], (v->u.a.size - index) * sizeof(lept_value));
+	v->u.a.size++;
+	lept_init(&v->u.a.e[index]);
+	return &v->u.a.e[index];
+}
+
+void lept_erase_array_element(lept_value* v, size_t index, size_t count) {
+	size_t i;
+	assert(v != NULL && v->type == LEPT_ARRAY && index + count <= v->u.a.size);
+	if (count == 0) /* an empty array may have no buffer to move within */
+		return;
+	for (i = index; i < index + count; i++)
+		lept_free(&v->u.a.e[i]);
+	memmove(&v->u.a.e[index], &v->u.a.e[index + count], (v->u.a.size - index - count) * sizeof(lept_value));
+	v->u.a.size -= count;
+}
+
+void lept_set_object(lept_value* v, size_t capacity) {
+	assert(v != NULL);
+	lept_free(v);
+	v->type = LEPT_OBJECT;
+	v->u.o.size = 0;
+	v->u.o.capacity = capacity;
+	v->u.o.m = capacity > 0 ? (lept_member*)malloc(capacity * sizeof(lept_member)) : NULL;
+}
+
 size_t lept_get_object_size(const lept_value* v) {
 	assert(v != NULL && v->type == LEPT_OBJECT);
 	return v->u.o.size;
 }
+
+size_t lept_get_object_capacity(const lept_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	return v->u.o.capacity;
+}
+
+void lept_reserve_object(lept_value* v, size_t capacity) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	if (v->u.o.capacity < capacity) {
+		v->u.o.capacity = capacity;
+		v->u.o.m = (lept_member*)realloc(v->u.o.m, capacity * sizeof(lept_member));
+	}
+}
+
+void lept_shrink_object(lept_value* v) {
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	if (v->u.o.capacity > v->u.o.size) {
+		v->u.o.capacity = v->u.o.size;
+		if (v->u.o.size == 0) {
+			free(v->u.o.m);
+			v->u.o.m = NULL;
+		}
+		else
+			v->u.o.m = (lept_member*)realloc(v->u.o.m, v->u.o.size * sizeof(lept_member));
+	}
+}
+
+void lept_clear_object(lept_value* v) {
+	size_t i;
+	assert(v != NULL && v->type == LEPT_OBJECT);
+	for (i = 0; i < v->u.o.size; i++) {
+		free(v->u.o.m[i].k);
+		lept_free(&v->u.o.m[i].v);
+	}
+	v->u.o.size = 0;
+}
 const char* lept_get_object_key(const lept_value* v, size_t index) {
 	assert(v != NULL&&v->type == LEPT_OBJECT);
 	assert(index < v->u.o.size);
@@ -423,4 +822,1639 @@ lept_value* lept_get_object_value(const lept_value* v, size_t index) {
 	assert(v != NULL&&v->type == LEPT_OBJECT);
 	assert(index < v->u.o.size);
 	return &v->u.o.m[index].v;
-}
\ No newline at end of file
+}
+
+/*----------------------CBOR------------------------------*/
+/* Major types of RFC 7049, already shifted into the top three bits. */
+#define LEPT_CBOR_UINT   0x00
+#define LEPT_CBOR_NINT   0x20
+#define LEPT_CBOR_TEXT   0x60
+#define LEPT_CBOR_ARRAY  0x80
+#define LEPT_CBOR_MAP    0xa0
+#define LEPT_CBOR_SIMPLE 0xe0
+
+#define LEPT_CBOR_FALSE  0xf4
+#define LEPT_CBOR_TRUE   0xf5
+#define LEPT_CBOR_NULL   0xf6
+#define LEPT_CBOR_HALF   0xf9
+#define LEPT_CBOR_FLOAT  0xfa
+#define LEPT_CBOR_DOUBLE 0xfb
+
+/* Doubles with an integral value below 2^53 are exact as CBOR integers. */
+#define LEPT_CBOR_MAX_EXACT_INT 9007199254740992.0
+
+#define PUTS(c, s, len) memcpy(lept_context_push(c, len), s, len)
+
+/* Bytes the argument n takes after the initial byte in its shortest form. */
+int lept_cbor_head_bytes(uint64_t n) {
+	return n < 24 ? 0 : n <= 0xff ? 1 : n <= 0xffff ? 2 : n <= 0xffffffffu ? 4 : 8;
+}
+
+/* Writes a head with an argument of the given size, which must be able to hold n. */
+void lept_cbor_write_head(unsigned char* p, int major, uint64_t n, int bytes) {
+	int i;
+	switch (bytes) {
+	case 0:  p[0] = (unsigned char)(major | (int)n); return;
+	case 1:  p[0] = (unsigned char)(major | 24); break;
+	case 2:  p[0] = (unsigned char)(major | 25); break;
+	case 4:  p[0] = (unsigned char)(major | 26); break;
+	default: p[0] = (unsigned char)(major | 27); break;
+	}
+	for (i = bytes; i > 0; i--, n >>= 8)
+		p[i] = (unsigned char)(n & 0xff);
+}
+
+void lept_cbor_put_head(lept_context* c, int major, uint64_t n) {
+	int bytes = lept_cbor_head_bytes(n);
+	lept_cbor_write_head((unsigned char*)lept_context_push(c, 1 + bytes), major, n, bytes);
+}
+
+void lept_cbor_put_double(lept_context* c, double d) {
+	unsigned char* p = (unsigned char*)lept_context_push(c, 9);
+	uint64_t bits;
+	int i;
+	memcpy(&bits, &d, sizeof(bits));
+	p[0] = LEPT_CBOR_DOUBLE;
+	for (i = 8; i > 0; i--, bits >>= 8)
+		p[i] = (unsigned char)(bits & 0xff);
+}
+
+void lept_cbor_put_number(lept_context* c, double n) {
+	if (n == floor(n) && n < LEPT_CBOR_MAX_EXACT_INT && n > -LEPT_CBOR_MAX_EXACT_INT && !(n == 0.0 && signbit(n))) {
+		if (n >= 0)
+			lept_cbor_put_head(c, LEPT_CBOR_UINT, (uint64_t)n);
+		else
+			lept_cbor_put_head(c, LEPT_CBOR_NINT, (uint64_t)(-1.0 - n));
+	}
+	else
+		lept_cbor_put_double(c, n);
+}
+
+void lept_encode_cbor_value(lept_context* c, const lept_value* v) {
+	size_t i;
+	switch (v->type) {
+	case LEPT_NULL:   PUTC(c, (char)LEPT_CBOR_NULL); break;
+	case LEPT_FALSE:  PUTC(c, (char)LEPT_CBOR_FALSE); break;
+	case LEPT_TRUE:   PUTC(c, (char)LEPT_CBOR_TRUE); break;
+	case LEPT_NUMBER: lept_cbor_put_number(c, v->u.n); break;
+	case LEPT_STRING:
+		lept_cbor_put_head(c, LEPT_CBOR_TEXT, v->u.s.len);
+		if (v->u.s.len > 0)
+			PUTS(c, v->u.s.s, v->u.s.len);
+		break;
+	case LEPT_ARRAY:
+		lept_cbor_put_head(c, LEPT_CBOR_ARRAY, v->u.a.size);
+		for (i = 0; i < v->u.a.size; i++)
+			lept_encode_cbor_value(c, &v->u.a.e[i]);
+		break;
+	case LEPT_OBJECT:
+		lept_cbor_put_head(c, LEPT_CBOR_MAP, v->u.o.size);
+		for (i = 0; i < v->u.o.size; i++) {
+			lept_cbor_put_head(c, LEPT_CBOR_TEXT, v->u.o.m[i].klen);
+			if (v->u.o.m[i].klen > 0)
+				PUTS(c, v->u.o.m[i].k, v->u.o.m[i].klen);
+			lept_encode_cbor_value(c, &v->u.o.m[i].v);
+		}
+		break;
+	default: assert(0 && "invalid type");
+	}
+}
+
+char* lept_encode_cbor(const lept_value* v, size_t* length) {
+	lept_context c;
+	assert(v != NULL && length != NULL);
+	c.stack = (char*)malloc(c.size = LEPT_PARSE_STACK_INIT_SIZE);
+	c.top = 0;
+	lept_encode_cbor_value(&c, v);
+	*length = c.top;
+	return c.stack;
+}
+
+struct lept_cbor_reader
+{
+	const unsigned char* p;
+	const unsigned char* end;
+};
+
+/* Reads the initial byte and its argument; indefinite lengths are rejected. */
+int lept_cbor_get_head(lept_cbor_reader* r, int* major, uint64_t* n) {
+	int info, bytes;
+	if (r->p == r->end)
+		return LEPT_PARSE_INVALID_CBOR;
+	*major = *r->p & 0xe0;
+	info = *r->p++ & 0x1f;
+	if (info < 24) {
+		*n = (uint64_t)info;
+		return LEPT_PARSE_OK;
+	}
+	switch (info) {
+	case 24: bytes = 1; break;
+	case 25: bytes = 2; break;
+	case 26: bytes = 4; break;
+	case 27: bytes = 8; break;
+	default: return LEPT_PARSE_INVALID_CBOR;
+	}
+	if (r->end - r->p < bytes)
+		return LEPT_PARSE_INVALID_CBOR;
+	for (*n = 0; bytes > 0; bytes--)
+		*n = (*n << 8) | *r->p++;
+	return LEPT_PARSE_OK;
+}
+
+double lept_cbor_half_to_double(unsigned int h) {
+	int exp = (h >> 10) & 0x1f;
+	double mant = h & 0x3ff;
+	double d;
+	if (exp == 0)
+		d = ldexp(mant, -24);
+	else if (exp != 31)
+		d = ldexp(mant + 1024, exp - 25);
+	else
+		d = mant == 0 ? HUGE_VAL : NAN;
+	return (h & 0x8000) ? -d : d;
+}
+
+/* Numbers come in as integers or floats; anything JSON cannot hold is invalid. */
+int lept_cbor_get_number(int initial, uint64_t n, double* d) {
+	float f;
+	uint32_t f32;
+	switch (initial) {
+	case LEPT_CBOR_HALF:
+		*d = lept_cbor_half_to_double((unsigned int)n);
+		break;
+	case LEPT_CBOR_FLOAT:
+		f32 = (uint32_t)n;
+		memcpy(&f, &f32, sizeof(f));
+		*d = f;
+		break;
+	case LEPT_CBOR_DOUBLE:
+		memcpy(d, &n, sizeof(*d));
+		break;
+	default:
+		switch (initial & 0xe0) {
+		case LEPT_CBOR_UINT: *d = (double)n; return LEPT_PARSE_OK;
+		case LEPT_CBOR_NINT: *d = -1.0 - (double)n; return LEPT_PARSE_OK;
+		default: return LEPT_PARSE_INVALID_CBOR;
+		}
+	}
+	return isfinite(*d) ? LEPT_PARSE_OK : LEPT_PARSE_INVALID_CBOR;
+}
+
+/*
+ * Control bytes the parser has an escape for are the only ones accepted: without \u
+ * support, any other could be decoded here but never written back as JSON that parses.
+ */
+int lept_cbor_get_text(lept_cbor_reader* r, const char** s, size_t* len) {
+	const unsigned char* p;
+	int major, ret;
+	uint64_t n;
+	if ((ret = lept_cbor_get_head(r, &major, &n)) != LEPT_PARSE_OK)
+		return ret;
+	if (major != LEPT_CBOR_TEXT || n > (uint64_t)(r->end - r->p))
+		return LEPT_PARSE_INVALID_CBOR;
+	for (p = r->p; p < r->p + n; p++)
+		if (*p < 0x20 && *p != '\b' && *p != '\f' && *p != '\n' && *p != '\r' && *p != '\t')
+			return LEPT_PARSE_INVALID_CBOR;
+	*s = (const char*)r->p;
+	*len = (size_t)n;
+	r->p += n;
+	return LEPT_PARSE_OK;
+}
+
+int lept_decode_cbor_value(lept_cbor_reader* r, lept_value* v) {
+	const unsigned char* start = r->p;
+	const char* s;
+	size_t i, len;
+	int major, ret;
+	uint64_t n;
+	if ((ret = lept_cbor_get_head(r, &major, &n)) != LEPT_PARSE_OK)
+		return ret;
+	switch (major) {
+	case LEPT_CBOR_TEXT:
+		r->p = start;
+		if ((ret = lept_cbor_get_text(r, &s, &len)) != LEPT_PARSE_OK)
+			return ret;
+		lept_set_string(v, s, len);
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_ARRAY:
+		/* every element takes at least one byte, which bounds the allocation */
+		if (n > (uint64_t)(r->end - r->p))
+			return LEPT_PARSE_INVALID_CBOR;
+		v->u.a.size = v->u.a.capacity = (size_t)n;
+		v->u.a.e = n ? (lept_value*)malloc((size_t)n * sizeof(lept_value)) : NULL;
+		for (i = 0; i < n; i++) {
+			lept_init(&v->u.a.e[i]);
+			if ((ret = lept_decode_cbor_value(r, &v->u.a.e[i])) != LEPT_PARSE_OK) {
+				v->u.a.size = i + 1;
+				v->type = LEPT_ARRAY;
+				lept_free(v);
+				return ret;
+			}
+		}
+		v->type = LEPT_ARRAY;
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_MAP:
+		if (n > (uint64_t)(r->end - r->p) / 2)
+			return LEPT_PARSE_INVALID_CBOR;
+		v->u.o.size = v->u.o.capacity = (size_t)n;
+		v->u.o.m = n ? (lept_member*)malloc((size_t)n * sizeof(lept_member)) : NULL;
+		for (i = 0; i < n; i++) {
+			lept_member* m = &v->u.o.m[i];
+			m->k = NULL;
+			lept_init(&m->v);
+			if ((ret = lept_cbor_get_text(r, &s, &len)) == LEPT_PARSE_OK) {
+				memcpy(m->k = (char*)malloc(len + 1), s, len);
+				m->k[len] = '\0';
+				m->klen = len;
+				ret = lept_decode_cbor_value(r, &m->v);
+			}
+			if (ret != LEPT_PARSE_OK) {
+				v->u.o.size = i + 1;
+				v->type = LEPT_OBJECT;
+				lept_free(v);
+				return ret;
+			}
+		}
+		v->type = LEPT_OBJECT;
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_SIMPLE:
+		if ((*start & 0x1f) < 24) {
+			switch (n) {
+			case LEPT_CBOR_FALSE & 0x1f: v->type = LEPT_FALSE; return LEPT_PARSE_OK;
+			case LEPT_CBOR_TRUE & 0x1f:  v->type = LEPT_TRUE; return LEPT_PARSE_OK;
+			case LEPT_CBOR_NULL & 0x1f:  v->type = LEPT_NULL; return LEPT_PARSE_OK;
+			default: return LEPT_PARSE_INVALID_CBOR;
+			}
+		}
+		/* fall through */
+	default:
+		if ((ret = lept_cbor_get_number(*start, n, &v->u.n)) != LEPT_PARSE_OK)
+			return ret;
+		v->type = LEPT_NUMBER;
+		return LEPT_PARSE_OK;
+	}
+}
+
+int lept_decode_cbor(lept_value* v, const char* cbor, size_t length) {
+	lept_cbor_reader r;
+	int ret;
+	assert(v != NULL && (cbor != NULL || length == 0));
+	r.p = (const unsigned char*)cbor;
+	r.end = r.p + length;
+	lept_init(v);
+	if ((ret = lept_decode_cbor_value(&r, v)) == LEPT_PARSE_OK && r.p != r.end) {
+		lept_free(v);
+		ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	}
+	return ret;
+}
+
+/* Other control bytes never get here, lept_cbor_get_text refuses them. */
+void lept_stringify_string(lept_context* c, const char* s, size_t len) {
+	size_t i;
+	PUTC(c, '"');
+	for (i = 0; i < len; i++) {
+		switch (s[i]) {
+		case '\"': PUTS(c, "\\\"", 2); break;
+		case '\\': PUTS(c, "\\\\", 2); break;
+		case '\b': PUTS(c, "\\b", 2); break;
+		case '\f': PUTS(c, "\\f", 2); break;
+		case '\n': PUTS(c, "\\n", 2); break;
+		case '\r': PUTS(c, "\\r", 2); break;
+		case '\t': PUTS(c, "\\t", 2); break;
+		default:
+			assert((unsigned char)s[i] >= 0x20);
+			PUTC(c, s[i]);
+		}
+	}
+	PUTC(c, '"');
+}
+
+void lept_stringify_number(lept_context* c, double n) {
+	c->top -= 32 - snprintf((char*)lept_context_push(c, 32), 32, "%.17g", n);
+}
+
+/* Writes JSON text straight from the byte stream, no lept_value is built. */
+int lept_cbor_to_json_value(lept_cbor_reader* r, lept_context* c) {
+	const unsigned char* start = r->p;
+	const char* s;
+	size_t len;
+	uint64_t i, n;
+	int major, ret;
+	double d;
+	if ((ret = lept_cbor_get_head(r, &major, &n)) != LEPT_PARSE_OK)
+		return ret;
+	switch (major) {
+	case LEPT_CBOR_TEXT:
+		r->p = start;
+		if ((ret = lept_cbor_get_text(r, &s, &len)) != LEPT_PARSE_OK)
+			return ret;
+		lept_stringify_string(c, s, len);
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_ARRAY:
+		PUTC(c, '[');
+		for (i = 0; i < n; i++) {
+			if (i > 0)
+				PUTC(c, ',');
+			if ((ret = lept_cbor_to_json_value(r, c)) != LEPT_PARSE_OK)
+				return ret;
+		}
+		PUTC(c, ']');
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_MAP:
+		PUTC(c, '{');
+		for (i = 0; i < n; i++) {
+			if (i > 0)
+				PUTC(c, ',');
+			if ((ret = lept_cbor_get_text(r, &s, &len)) != LEPT_PARSE_OK)
+				return ret;
+			lept_stringify_string(c, s, len);
+			PUTC(c, ':');
+			if ((ret = lept_cbor_to_json_value(r, c)) != LEPT_PARSE_OK)
+				return ret;
+		}
+		PUTC(c, '}');
+		return LEPT_PARSE_OK;
+	case LEPT_CBOR_SIMPLE:
+		if ((*start & 0x1f) < 24) {
+			switch (n) {
+			case LEPT_CBOR_FALSE & 0x1f: PUTS(c, "false", 5); return LEPT_PARSE_OK;
+			case LEPT_CBOR_TRUE & 0x1f:  PUTS(c, "true", 4); return LEPT_PARSE_OK;
+			case LEPT_CBOR_NULL & 0x1f:  PUTS(c, "null", 4); return LEPT_PARSE_OK;
+			default: return LEPT_PARSE_INVALID_CBOR;
+			}
+		}
+		/* fall through */
+	default:
+		if ((ret = lept_cbor_get_number(*start, n, &d)) != LEPT_PARSE_OK)
+			return ret;
+		lept_stringify_number(c, d);
+		return LEPT_PARSE_OK;
+	}
+}
+
+int lept_cbor_to_json(const char* cbor, size_t length, char** json, size_t* json_length) {
+	lept_cbor_reader r;
+	lept_context c;
+	int ret;
+	assert(json != NULL && (cbor != NULL || length == 0));
+	r.p = (const unsigned char*)cbor;
+	r.end = r.p + length;
+	c.stack = (char*)malloc(c.size = LEPT_PARSE_STACK_INIT_SIZE);
+	c.top = 0;
+	if ((ret = lept_cbor_to_json_value(&r, &c)) == LEPT_PARSE_OK && r.p != r.end)
+		ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	if (ret != LEPT_PARSE_OK) {
+		free(c.stack);
+		*json = NULL;
+		if (json_length)
+			*json_length = 0;
+		return ret;
+	}
+	if (json_length)
+		*json_length = c.top;
+	PUTC(&c, '\0');
+	*json = c.stack;
+	return LEPT_PARSE_OK;
+}
+
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen) {
+	size_t i;
+	assert(v != NULL && v->type == LEPT_OBJECT && key != NULL);
+	for (i = 0; i < v->u.o.size; i++)
+		if (v->u.o.m[i].klen == klen && memcmp(v->u.o.m[i].k, key, klen) == 0)
+			return i;
+	return LEPT_KEY_NOT_EXIST;
+}
+
+lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen) {
+	size_t index = lept_find_object_index(v, key, klen);
+	return index != LEPT_KEY_NOT_EXIST ? &v->u.o.m[index].v : NULL;
+}
+
+/* Adds a member without looking for one of the same key, for callers that already have. */
+lept_value* lept_append_object_value(lept_value* v, const char* key, size_t klen) {
+	lept_member* m;
+	if (v->u.o.size == v->u.o.capacity)
+		lept_reserve_object(v, v->u.o.capacity == 0 ? 1 : v->u.o.capacity * 2);
+	m = &v->u.o.m[v->u.o.size++];
+	memcpy(m->k = (char*)malloc(klen + 1), key, klen);
+	m->k[klen] = '\0';
+	m->klen = klen;
+	lept_init(&m->v);
+	return &m->v;
+}
+
+/* Returns the existing value for key, or appends a null one. */
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen) {
+	size_t index = lept_find_object_index(v, key, klen);
+	if (index != LEPT_KEY_NOT_EXIST)
+		return &v->u.o.m[index].v;
+	return lept_append_object_value(v, key, klen);
+}
+
+void lept_remove_object_value(lept_value* v, size_t index) {
+	assert(v != NULL && v->type == LEPT_OBJECT && index < v->u.o.size);
+	free(v->u.o.m[index].k);
+	lept_free(&v->u.o.m[index].v);
+	memmove(&v->u.o.m[index], &v->u.o.m[index + 1], (v->u.o.size - index - 1) * sizeof(lept_member));
+	v->u.o.size--;
+}
+
+/* Deep copy into dst, which must be null. */
+void lept_copy_value(lept_value* dst, const lept_value* src) {
+	size_t i;
+	switch (src->type) {
+	case LEPT_STRING:
+		lept_set_string(dst, src->u.s.s, src->u.s.len);
+		break;
+	case LEPT_ARRAY:
+		lept_set_array(dst, src->u.a.size);
+		for (i = 0; i < src->u.a.size; i++) {
+			lept_init(&dst->u.a.e[i]);
+			lept_copy_value(&dst->u.a.e[i], &src->u.a.e[i]);
+		}
+		dst->u.a.size = src->u.a.size;
+		break;
+	case LEPT_OBJECT:
+		/* members are appended as-is, duplicate keys from the source are kept */
+		lept_set_object(dst, src->u.o.size);
+		for (i = 0; i < src->u.o.size; i++) {
+			lept_member* m = &dst->u.o.m[i];
+			memcpy(m->k = (char*)malloc(src->u.o.m[i].klen + 1), src->u.o.m[i].k, src->u.o.m[i].klen + 1);
+			m->klen = src->u.o.m[i].klen;
+			lept_init(&m->v);
+			lept_copy_value(&m->v, &src->u.o.m[i].v);
+		}
+		dst->u.o.size = src->u.o.size;
+		break;
+	default:
+		memcpy(dst, src, sizeof(lept_value));
+		break;
+	}
+}
+
+/* The copy is built aside, since src may live inside dst and go when dst is freed. */
+void lept_copy(lept_value* dst, const lept_value* src) {
+	lept_value temp;
+	assert(src != NULL && dst != NULL && src != dst);
+	lept_init(&temp);
+	lept_copy_value(&temp, src);
+	lept_move(dst, &temp);
+}
+
+/* src is taken out before dst is freed, since it may live inside dst. */
+void lept_move(lept_value* dst, lept_value* src) {
+	lept_value temp;
+	assert(dst != NULL && src != NULL && src != dst);
+	memcpy(&temp, src, sizeof(lept_value));
+	lept_init(src);
+	lept_free(dst);
+	memcpy(dst, &temp, sizeof(lept_value));
+}
+
+void lept_swap(lept_value* lhs, lept_value* rhs) {
+	assert(lhs != NULL && rhs != NULL);
+	if (lhs != rhs) {
+		lept_value temp;
+		memcpy(&temp, lhs, sizeof(lept_value));
+		memcpy(lhs, rhs, sizeof(lept_value));
+		memcpy(rhs, &temp, sizeof(lept_value));
+	}
+}
+
+/*----------------------document--------------------------*/
+struct lept_document_entry
+{
+	const lept_value* object;
+	const lept_member* m;
+};
+
+struct lept_document
+{
+	std::atomic<size_t> refcount;
+	lept_value root;
+	lept_document_entry* index; /* open addressing over every member of every object */
+	size_t index_mask;
+};
+
+struct lept_document_slot
+{
+	std::atomic<lept_document*> current;
+	std::atomic<unsigned int> epoch;
+	std::atomic<size_t> readers[2]; /* acquires in flight, by epoch parity */
+	std::mutex publish;
+};
+
+size_t lept_document_hash(const lept_value* object, const char* key, size_t klen) {
+	uint64_t h = 14695981039346656037ull ^ (uint64_t)(uintptr_t)object;
+	size_t i;
+	for (i = 0; i < klen; i++)
+		h = (h ^ (unsigned char)key[i]) * 1099511628211ull;
+	return (size_t)(h ^ (h >> 32));
+}
+
+size_t lept_document_count_members(const lept_value* v) {
+	size_t i, n = 0;
+	if (v->type == LEPT_ARRAY)
+		for (i = 0; i < v->u.a.size; i++)
+			n += lept_document_count_members(&v->u.a.e[i]);
+	else if (v->type == LEPT_OBJECT)
+		for (i = 0, n = v->u.o.size; i < v->u.o.size; i++)
+			n += lept_document_count_members(&v->u.o.m[i].v);
+	return n;
+}
+
+/* Members are inserted in order, so a probe meets the first of duplicate keys first. */
+void lept_document_index(lept_document* doc, const lept_value* v) {
+	size_t i, j;
+	if (v->type == LEPT_ARRAY)
+		for (i = 0; i < v->u.a.size; i++)
+			lept_document_index(doc, &v->u.a.e[i]);
+	else if (v->type == LEPT_OBJECT)
+		for (i = 0; i < v->u.o.size; i++) {
+			const lept_member* m = &v->u.o.m[i];
+			for (j = lept_document_hash(v, m->k, m->klen); doc->index[j & doc->index_mask].m != NULL; j++);
+			doc->index[j & doc->index_mask].object = v;
+			doc->index[j & doc->index_mask].m = m;
+			lept_document_index(doc, &m->v);
+		}
+}
+
+lept_document* lept_document_create(lept_value* v) {
+	lept_document* doc = new lept_document;
+	size_t n, capacity = 1;
+	assert(v != NULL);
+	doc->refcount.store(1);
+	lept_init(&doc->root);
+	lept_move(&doc->root, v);
+	/* keep the load factor at or below one half */
+	for (n = lept_document_count_members(&doc->root); capacity < 2 * n; capacity <<= 1);
+	doc->index_mask = capacity - 1;
+	doc->index = (lept_document_entry*)calloc(capacity, sizeof(lept_document_entry));
+	lept_document_index(doc, &doc->root);
+	return doc;
+}
+
+int lept_document_parse(lept_document** doc, const char* json) {
+	lept_value v;
+	int ret;
+	assert(doc != NULL);
+	*doc = NULL;
+	if ((ret = lept_parse(&v, json)) == LEPT_PARSE_OK)
+		*doc = lept_document_create(&v);
+	return ret;
+}
+
+lept_document* lept_document_retain(lept_document* doc) {
+	assert(doc != NULL);
+	doc->refcount.fetch_add(1, std::memory_order_relaxed);
+	return doc;
+}
+
+void lept_document_release(lept_document* doc) {
+	if (doc != NULL && doc->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		free(doc->index);
+		lept_free(&doc->root);
+		delete doc;
+	}
+}
+
+const lept_value* lept_document_get_root(const lept_document* doc) {
+	assert(doc != NULL);
+	return &doc->root;
+}
+
+const lept_value* lept_document_find_object_value(const lept_document* doc, const lept_value* object, const char* key, size_t klen) {
+	size_t i;
+	assert(doc != NULL && object != NULL && object->type == LEPT_OBJECT && (key != NULL || klen == 0));
+	for (i = lept_document_hash(object, key, klen); doc->index[i & doc->index_mask].m != NULL; i++) {
+		const lept_document_entry* e = &doc->index[i & doc->index_mask];
+		if (e->object == object && e->m->klen == klen && memcmp(e->m->k, key, klen) == 0)
+			return &e->m->v;
+	}
+	return NULL;
+}
+
+lept_document_slot* lept_document_slot_create(lept_document* doc) {
+	lept_document_slot* slot = new lept_document_slot;
+	assert(doc != NULL);
+	slot->current.store(doc);
+	slot->epoch.store(0);
+	slot->readers[0].store(0);
+	slot->readers[1].store(0);
+	return slot;
+}
+
+void lept_document_slot_destroy(lept_document_slot* slot) {
+	assert(slot != NULL);
+	lept_document_release(slot->current.load());
+	delete slot;
+}
+
+/*
+ * A reader registers under the current epoch before loading the pointer, so
+ * the publisher that retires the old document knows whose retain it must wait
+ * for. Readers arriving after the epoch flip count against the other parity
+ * and can only see the new document, so the publisher cannot be starved.
+ */
+lept_document* lept_document_slot_acquire(lept_document_slot* slot) {
+	lept_document* doc;
+	unsigned int epoch;
+	assert(slot != NULL);
+	for (;;) {
+		epoch = slot->epoch.load();
+		slot->readers[epoch & 1].fetch_add(1);
+		if (slot->epoch.load() == epoch)
+			break;
+		slot->readers[epoch & 1].fetch_sub(1);
+	}
+	doc = lept_document_retain(slot->current.load());
+	slot->readers[epoch & 1].fetch_sub(1);
+	return doc;
+}
+
+void lept_document_slot_publish(lept_document_slot* slot, lept_document* doc) {
+	lept_document* old;
+	unsigned int epoch;
+	assert(slot != NULL && doc != NULL);
+	std::lock_guard<std::mutex> lock(slot->publish);
+	old = slot->current.exchange(doc);
+	epoch = slot->epoch.fetch_add(1);
+	while (slot->readers[epoch & 1].load() != 0)
+		std::this_thread::yield();
+	lept_document_release(old);
+}
+
+/*----------------------equality / hash--------------------------*/
+/* splitmix64 finalizer */
+uint64_t lept_hash_mix(uint64_t h) {
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ull;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebull;
+	return h ^ (h >> 31);
+}
+
+uint64_t lept_hash_string(const char* s, size_t len) {
+	uint64_t h = 14695981039346656037ull;
+	size_t i;
+	for (i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 1099511628211ull;
+	return lept_hash_mix(h ^ len);
+}
+
+/* Hash of a scalar; containers combine their children with the functions below. */
+uint64_t lept_hash_scalar(const lept_value* v) {
+	uint64_t bits;
+	double n;
+	switch (v->type) {
+	case LEPT_NUMBER:
+		n = v->u.n == 0.0 ? 0.0 : v->u.n; /* -0 == 0 */
+		memcpy(&bits, &n, sizeof(bits));
+		return lept_hash_mix(bits ^ LEPT_NUMBER);
+	case LEPT_STRING:
+		return lept_hash_string(v->u.s.s, v->u.s.len) ^ LEPT_STRING;
+	default:
+		return lept_hash_mix(v->type);
+	}
+}
+
+/* Array elements are chained in order. */
+uint64_t lept_hash_array_step(uint64_t h, uint64_t element) {
+	return lept_hash_mix(h * 31 + element);
+}
+
+/* Object members are summed, so the hash does not depend on member order. */
+uint64_t lept_hash_member(const lept_member* m, uint64_t value) {
+	return lept_hash_mix(lept_hash_string(m->k, m->klen) + 0x9e3779b97f4a7c15ull * value);
+}
+
+/* Open addressing table of member indices, keyed by member name. */
+struct lept_key_index
+{
+	size_t* slots; /* member index + 1, 0 for an empty slot */
+	size_t mask;
+};
+
+void lept_key_index_build(lept_key_index* index, const lept_value* object) {
+	size_t i, j, capacity = 1;
+	assert(object->type == LEPT_OBJECT);
+	while (capacity < 2 * object->u.o.size)
+		capacity <<= 1;
+	index->mask = capacity - 1;
+	index->slots = (size_t*)calloc(capacity, sizeof(size_t));
+	for (i = 0; i < object->u.o.size; i++) {
+		const lept_member* m = &object->u.o.m[i];
+		for (j = (size_t)lept_hash_string(m->k, m->klen); index->slots[j & index->mask] != 0; j++);
+		index->slots[j & index->mask] = i + 1;
+	}
+}
+
+size_t lept_key_index_find(const lept_key_index* index, const lept_value* object, const char* key, size_t klen) {
+	size_t j;
+	for (j = (size_t)lept_hash_string(key, klen); index->slots[j & index->mask] != 0; j++) {
+		const lept_member* m = &object->u.o.m[index->slots[j & index->mask] - 1];
+		if (m->klen == klen && memcmp(m->k, key, klen) == 0)
+			return index->slots[j & index->mask] - 1;
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+/* Objects this small are matched by scanning, building an index would cost more. */
+#define LEPT_KEY_INDEX_MIN_SIZE 8
+
+/* Type, scalar value and container size; children are left to the caller. */
+int lept_is_equal_shallow(const lept_value* lhs, const lept_value* rhs) {
+	if (lhs->type != rhs->type)
+		return 0;
+	switch (lhs->type) {
+	case LEPT_NUMBER: return lhs->u.n == rhs->u.n;
+	case LEPT_STRING: return lhs->u.s.len == rhs->u.s.len && memcmp(lhs->u.s.s, rhs->u.s.s, lhs->u.s.len) == 0;
+	case LEPT_ARRAY:  return lhs->u.a.size == rhs->u.a.size;
+	case LEPT_OBJECT: return lhs->u.o.size == rhs->u.o.size;
+	default:          return 1;
+	}
+}
+
+struct lept_equal_frame
+{
+	const lept_value* lhs;
+	const lept_value* rhs;
+	size_t next;
+	lept_key_index index; /* over rhs, built on the first out-of-order member of a large object */
+	unsigned char* used;  /* bitmap of rhs members already paired, objects only */
+	size_t prefix;        /* rhs members before this one are all paired */
+};
+
+void lept_equal_push(lept_context* c, const lept_value* lhs, const lept_value* rhs) {
+	lept_equal_frame* f = (lept_equal_frame*)lept_context_push(c, sizeof(lept_equal_frame));
+	f->lhs = lhs;
+	f->rhs = rhs;
+	f->next = 0;
+	f->index.slots = NULL;
+	f->used = NULL;
+	f->prefix = 0;
+	if (rhs->type == LEPT_OBJECT)
+		f->used = (unsigned char*)calloc((rhs->u.o.size + 7) / 8, 1);
+}
+
+#define LEPT_EQUAL_USED(f, j) ((f)->used[(j) >> 3] & (1u << ((j) & 7)))
+
+/*
+ * Pairs an lhs member with the first unpaired rhs member of the same key, so the n-th
+ * duplicate of a key on one side always meets the n-th duplicate on the other and the
+ * result does not depend on argument order. Members in the same order need no lookup.
+ */
+size_t lept_equal_match(lept_equal_frame* f, const lept_member* m) {
+	size_t j = f->next - 1, k;
+	const lept_member* r = &f->rhs->u.o.m[j];
+	if (f->prefix == j && r->klen == m->klen && memcmp(r->k, m->k, m->klen) == 0)
+		return j;
+	if (f->index.slots == NULL && f->rhs->u.o.size >= LEPT_KEY_INDEX_MIN_SIZE)
+		lept_key_index_build(&f->index, f->rhs);
+	if (f->index.slots != NULL) {
+		/* linear probing keeps members of one key in insertion order along the probe sequence */
+		for (k = (size_t)lept_hash_string(m->k, m->klen); f->index.slots[k & f->index.mask] != 0; k++) {
+			j = f->index.slots[k & f->index.mask] - 1;
+			r = &f->rhs->u.o.m[j];
+			if (!LEPT_EQUAL_USED(f, j) && r->klen == m->klen && memcmp(r->k, m->k, m->klen) == 0)
+				return j;
+		}
+		return LEPT_KEY_NOT_EXIST;
+	}
+	for (j = f->prefix; j < f->rhs->u.o.size; j++) {
+		r = &f->rhs->u.o.m[j];
+		if (!LEPT_EQUAL_USED(f, j) && r->klen == m->klen && memcmp(r->k, m->k, m->klen) == 0)
+			return j;
+	}
+	return LEPT_KEY_NOT_EXIST;
+}
+
+/* Walks both trees with an explicit stack, so nesting depth is not limited by the call stack. */
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs) {
+	lept_context c;
+	lept_equal_frame* f;
+	int equal;
+	assert(lhs != NULL && rhs != NULL);
+	c.stack = NULL;
+	c.size = c.top = 0;
+	if ((equal = lept_is_equal_shallow(lhs, rhs)) && (lhs->type == LEPT_ARRAY || lhs->type == LEPT_OBJECT))
+		lept_equal_push(&c, lhs, rhs);
+	while (equal && c.top > 0) {
+		const lept_value* a;
+		const lept_value* b;
+		f = (lept_equal_frame*)(c.stack + c.top - sizeof(lept_equal_frame));
+		if (f->lhs->type == LEPT_ARRAY) {
+			if (f->next == f->lhs->u.a.size) {
+				lept_context_pop(&c, sizeof(lept_equal_frame));
+				continue;
+			}
+			a = &f->lhs->u.a.e[f->next];
+			b = &f->rhs->u.a.e[f->next++];
+		}
+		else {
+			const lept_member* m;
+			size_t j;
+			if (f->next == f->lhs->u.o.size) {
+				free(f->index.slots);
+				free(f->used);
+				lept_context_pop(&c, sizeof(lept_equal_frame));
+				continue;
+			}
+			m = &f->lhs->u.o.m[f->next++];
+			if ((j = lept_equal_match(f, m)) == LEPT_KEY_NOT_EXIST) {
+				equal = 0;
+				break;
+			}
+			f->used[j >> 3] |= (unsigned char)(1u << (j & 7));
+			while (f->prefix < f->rhs->u.o.size && LEPT_EQUAL_USED(f, f->prefix))
+				f->prefix++;
+			a = &m->v;
+			b = &f->rhs->u.o.m[j].v;
+		}
+		if ((equal = lept_is_equal_shallow(a, b)) && (a->type == LEPT_ARRAY || a->type == LEPT_OBJECT))
+			lept_equal_push(&c, a, b);
+	}
+	while (c.top > 0) {
+		f = (lept_equal_frame*)lept_context_pop(&c, sizeof(lept_equal_frame));
+		free(f->index.slots);
+		free(f->used);
+	}
+	free(c.stack);
+	return equal;
+}
+
+struct lept_hash_frame
+{
+	const lept_value* v;
+	size_t next;
+	uint64_t h;
+};
+
+void lept_hash_push(lept_context* c, const lept_value* v) {
+	lept_hash_frame* f = (lept_hash_frame*)lept_context_push(c, sizeof(lept_hash_frame));
+	f->v = v;
+	f->next = 0;
+	f->h = v->type == LEPT_ARRAY ? lept_hash_mix(LEPT_ARRAY) : 0;
+}
+
+/* Folds the hash of the finished child into the frame on top of the stack. */
+void lept_hash_fold(lept_context* c, uint64_t h) {
+	lept_hash_frame* f = (lept_hash_frame*)(c->stack + c->top - sizeof(lept_hash_frame));
+	if (f->v->type == LEPT_ARRAY)
+		f->h = lept_hash_array_step(f->h, h);
+	else
+		f->h += lept_hash_member(&f->v->u.o.m[f->next], h);
+	f->next++;
+}
+
+/* Post-order walk with an explicit stack. */
+uint64_t lept_hash(const lept_value* v) {
+	lept_context c;
+	lept_hash_frame* f;
+	uint64_t h;
+	assert(v != NULL);
+	c.stack = NULL;
+	c.size = c.top = 0;
+	for (;;) {
+		if (v->type == LEPT_ARRAY || v->type == LEPT_OBJECT)
+			lept_hash_push(&c, v);
+		else {
+			h = lept_hash_scalar(v);
+			if (c.top == 0)
+				break;
+			lept_hash_fold(&c, h);
+		}
+		/* close every container whose children are all hashed */
+		for (;;) {
+			f = (lept_hash_frame*)(c.stack + c.top - sizeof(lept_hash_frame));
+			if (f->next < (f->v->type == LEPT_ARRAY ? f->v->u.a.size : f->v->u.o.size))
+				break;
+			h = f->v->type == LEPT_ARRAY ? f->h : lept_hash_mix(f->h ^ LEPT_OBJECT);
+			lept_context_pop(&c, sizeof(lept_hash_frame));
+			if (c.top == 0)
+				break;
+			lept_hash_fold(&c, h);
+		}
+		if (c.top == 0)
+			break;
+		v = f->v->type == LEPT_ARRAY ? &f->v->u.a.e[f->next] : &f->v->u.o.m[f->next].v;
+	}
+	free(c.stack);
+	return h;
+}
+
+/*----------------------diff / patch--------------------------*/
+/*
+ * Subtrees are compared with lept_is_equal, which stops at the first difference, so
+ * unchanged parts are walked once and nothing is stored per node.
+ */
+struct lept_diff_context
+{
+	lept_context path; /* JSON Pointer of the current node */
+	lept_value* patch;
+};
+
+void lept_diff_push_token(lept_context* c, const char* s, size_t len) {
+	size_t i;
+	PUTC(c, '/');
+	for (i = 0; i < len; i++) {
+		switch (s[i]) {
+		case '~': PUTS(c, "~0", 2); break;
+		case '/': PUTS(c, "~1", 2); break;
+		default:  PUTC(c, s[i]);
+		}
+	}
+}
+
+void lept_diff_push_index(lept_context* c, size_t index) {
+	char buffer[24];
+	char* p = buffer + sizeof(buffer);
+	do {
+		*--p = (char)('0' + index % 10);
+		index /= 10;
+	} while (index > 0);
+	PUTC(c, '/');
+	PUTS(c, p, buffer + sizeof(buffer) - p);
+}
+
+void lept_diff_add_op(lept_diff_context* d, const char* op, const lept_value* value) {
+	lept_value* o = lept_pushback_array_element(d->patch);
+	lept_set_object(o, value != NULL ? 3 : 2);
+	lept_set_string(lept_set_object_value(o, "op", 2), op, strlen(op));
+	lept_set_string(lept_set_object_value(o, "path", 4), d->path.top > 0 ? d->path.stack : "", d->path.top);
+	if (value != NULL)
+		lept_copy(lept_set_object_value(o, "value", 5), value);
+}
+
+void lept_diff_value(lept_diff_context* d, const lept_value* a, const lept_value* b);
+
+void lept_diff_array(lept_diff_context* d, const lept_value* a, const lept_value* b) {
+	size_t n = a->u.a.size, m = b->u.a.size, prefix, suffix, i, top = d->path.top;
+	/* trimming the equal ends keeps a single insertion or removal from shifting the rest */
+	for (prefix = 0; prefix < n && prefix < m && lept_is_equal(&a->u.a.e[prefix], &b->u.a.e[prefix]); prefix++);
+	for (suffix = 0; prefix + suffix < n && prefix + suffix < m && lept_is_equal(&a->u.a.e[n - 1 - suffix], &b->u.a.e[m - 1 - suffix]); suffix++);
+	n -= prefix + suffix;
+	m -= prefix + suffix;
+	for (i = 0; i < n && i < m; i++) {
+		lept_diff_push_index(&d->path, prefix + i);
+		lept_diff_value(d, &a->u.a.e[prefix + i], &b->u.a.e[prefix + i]);
+		d->path.top = top;
+	}
+	for (; i < n; i++) {
+		lept_diff_push_index(&d->path, prefix + m);
+		lept_diff_add_op(d, "remove", NULL);
+		d->path.top = top;
+	}
+	for (; i < m; i++) {
+		lept_diff_push_index(&d->path, prefix + i);
+		lept_diff_add_op(d, "add", &b->u.a.e[prefix + i]);
+		d->path.top = top;
+	}
+}
+
+void lept_diff_object(lept_diff_context* d, const lept_value* a, const lept_value* b) {
+	lept_key_index index;
+	size_t i, j, top = d->path.top;
+	char* matched = (char*)calloc(b->u.o.size + 1, 1);
+	lept_key_index_build(&index, b);
+	for (i = 0; i < a->u.o.size; i++) {
+		const lept_member* m = &a->u.o.m[i];
+		lept_diff_push_token(&d->path, m->k, m->klen);
+		if ((j = lept_key_index_find(&index, b, m->k, m->klen)) == LEPT_KEY_NOT_EXIST)
+			lept_diff_add_op(d, "remove", NULL);
+		else {
+			matched[j] = 1;
+			lept_diff_value(d, &m->v, &b->u.o.m[j].v);
+		}
+		d->path.top = top;
+	}
+	for (j = 0; j < b->u.o.size; j++) {
+		if (!matched[j]) {
+			lept_diff_push_token(&d->path, b->u.o.m[j].k, b->u.o.m[j].klen);
+			lept_diff_add_op(d, "add", &b->u.o.m[j].v);
+			d->path.top = top;
+		}
+	}
+	free(index.slots);
+	free(matched);
+}
+
+void lept_diff_value(lept_diff_context* d, const lept_value* a, const lept_value* b) {
+	if (lept_is_equal(a, b))
+		return;
+	if (a->type == LEPT_ARRAY && b->type == LEPT_ARRAY)
+		lept_diff_array(d, a, b);
+	else if (a->type == LEPT_OBJECT && b->type == LEPT_OBJECT)
+		lept_diff_object(d, a, b);
+	else
+		lept_diff_add_op(d, "replace", b);
+}
+
+void lept_diff(const lept_value* a, const lept_value* b, lept_value* patch) {
+	lept_diff_context d;
+	assert(a != NULL && b != NULL && patch != NULL);
+	lept_set_array(patch, 0);
+	d.patch = patch;
+	d.path.stack = NULL;
+	d.path.size = d.path.top = 0;
+	lept_diff_value(&d, a, b);
+	free(d.path.stack);
+}
+
+/* Unescapes the reference token path[0, len) into c, returning its length. */
+size_t lept_pointer_token(lept_context* c, const char* path, size_t len) {
+	size_t i, top = c->top;
+	for (i = 0; i < len; i++) {
+		if (path[i] == '~' && i + 1 < len && (path[i + 1] == '0' || path[i + 1] == '1'))
+			PUTC(c, path[++i] == '0' ? '~' : '/');
+		else
+			PUTC(c, path[i]);
+	}
+	return c->top - top;
+}
+
+/* Array index token: "0" or a number without leading zero; "-" is one past the end. */
+int lept_pointer_index(const char* token, size_t len, size_t size, size_t* index) {
+	size_t i;
+	if (len == 1 && token[0] == '-') {
+		*index = size;
+		return 1;
+	}
+	if (len == 0 || (token[0] == '0' && len > 1))
+		return 0;
+	for (i = 0, *index = 0; i < len; i++) {
+		if (!ISDIGIT(token[i]) || *index > ((size_t)-1 - 9) / 10)
+			return 0;
+		*index = *index * 10 + (token[i] - '0');
+	}
+	return 1;
+}
+
+/*
+ * Key indices of the objects a patch touches, so that an operation costs what it changes
+ * rather than a scan of every wide object on its path. An object is keyed by its member
+ * array, which stays put when the object itself is moved around inside its parent.
+ */
+struct lept_patch_context
+{
+	lept_context c; /* the last unescaped reference token */
+	std::unordered_map<const lept_member*, lept_key_index> indices;
+};
+
+/* Key lookup, through a cached index for objects of at least LEPT_KEY_INDEX_MIN_SIZE members. */
+size_t lept_patch_find(lept_patch_context* p, lept_value* object, const char* key, size_t klen) {
+	std::unordered_map<const lept_member*, lept_key_index>::iterator it;
+	if (object->u.o.size < LEPT_KEY_INDEX_MIN_SIZE)
+		return lept_find_object_index(object, key, klen);
+	if ((it = p->indices.find(object->u.o.m)) == p->indices.end()) {
+		it = p->indices.insert(std::make_pair((const lept_member*)object->u.o.m, lept_key_index())).first;
+		lept_key_index_build(&it->second, object);
+	}
+	return lept_key_index_find(&it->second, object, key, klen);
+}
+
+/* Drops the index of object, which is about to change in a way the index cannot follow. */
+void lept_patch_drop(lept_patch_context* p, const lept_value* object) {
+	std::unordered_map<const lept_member*, lept_key_index>::iterator it = p->indices.find(object->u.o.m);
+	if (it != p->indices.end()) {
+		free(it->second.slots);
+		p->indices.erase(it);
+	}
+}
+
+/* Drops the indices of every object in v, before v is freed and its member arrays reused. */
+void lept_patch_forget(lept_patch_context* p, const lept_value* v) {
+	size_t i;
+	if (p->indices.empty())
+		return;
+	if (v->type == LEPT_ARRAY)
+		for (i = 0; i < v->u.a.size; i++)
+			lept_patch_forget(p, &v->u.a.e[i]);
+	else if (v->type == LEPT_OBJECT) {
+		lept_patch_drop(p, v);
+		for (i = 0; i < v->u.o.size; i++)
+			lept_patch_forget(p, &v->u.o.m[i].v);
+	}
+}
+
+/* Appends a member of a key object does not have yet, keeping its index, if any, in step. */
+lept_value* lept_patch_append(lept_patch_context* p, lept_value* object, const char* key, size_t klen) {
+	std::unordered_map<const lept_member*, lept_key_index>::iterator it = p->indices.find(object->u.o.m);
+	lept_key_index index;
+	lept_value* v;
+	size_t j;
+	if (it == p->indices.end())
+		return lept_append_object_value(object, key, klen);
+	index = it->second;
+	p->indices.erase(it);
+	v = lept_append_object_value(object, key, klen);
+	if (2 * object->u.o.size > index.mask + 1) {
+		free(index.slots);
+		lept_key_index_build(&index, object);
+	}
+	else {
+		for (j = (size_t)lept_hash_string(key, klen); index.slots[j & index.mask] != 0; j++);
+		index.slots[j & index.mask] = object->u.o.size;
+	}
+	p->indices[object->u.o.m] = index;
+	return v;
+}
+
+/* Takes member i out of object's index, if any, before the member itself is removed. */
+void lept_patch_unindex(lept_patch_context* p, lept_value* object, size_t i) {
+	std::unordered_map<const lept_member*, lept_key_index>::iterator it = p->indices.find(object->u.o.m);
+	size_t* slots;
+	size_t mask, hole, j, home;
+	if (it == p->indices.end())
+		return;
+	slots = it->second.slots;
+	mask = it->second.mask;
+	for (hole = (size_t)lept_hash_string(object->u.o.m[i].k, object->u.o.m[i].klen); slots[hole & mask] != i + 1; hole++);
+	/* backward shift: pull up later entries of the cluster whose home is not past the hole */
+	for (j = hole + 1; slots[j & mask] != 0; j++) {
+		const lept_member* m = &object->u.o.m[slots[j & mask] - 1];
+		home = (size_t)lept_hash_string(m->k, m->klen);
+		if (((j - home) & mask) >= ((j - hole) & mask)) {
+			slots[hole & mask] = slots[j & mask];
+			hole = j;
+		}
+	}
+	slots[hole & mask] = 0;
+	/* the members after i move down by one */
+	for (j = 0; j <= mask; j++)
+		if (slots[j] > i + 1)
+			slots[j]--;
+}
+
+/* Resolves path; with parent set, stops one level short and leaves the last token in p->c. */
+lept_value* lept_pointer_resolve(lept_patch_context* p, lept_value* v, const char* path, size_t len, int parent, size_t* token_len) {
+	lept_context* c = &p->c;
+	const char* end = path + len;
+	size_t tlen, index;
+	if (len > 0 && *path != '/')
+		return NULL;
+	while (path < end) {
+		const char* next = path + 1;
+		while (next < end && *next != '/')
+			next++;
+		c->top = 0;
+		tlen = lept_pointer_token(c, path + 1, next - path - 1);
+		if (parent && next == end) {
+			*token_len = tlen;
+			return v;
+		}
+		if (v->type == LEPT_OBJECT) {
+			if ((index = lept_patch_find(p, v, tlen > 0 ? c->stack : "", tlen)) == LEPT_KEY_NOT_EXIST)
+				return NULL;
+			v = &v->u.o.m[index].v;
+		}
+		else if (v->type == LEPT_ARRAY) {
+			if (!lept_pointer_index(c->stack, tlen, v->u.a.size, &index) || index >= v->u.a.size)
+				return NULL;
+			v = &v->u.a.e[index];
+		}
+		else
+			return NULL;
+		path = next;
+	}
+	return parent ? NULL : v;
+}
+
+const lept_value* lept_patch_member(const lept_value* op, const char* key, size_t klen, lept_type type) {
+	const lept_value* v = lept_find_object_value((lept_value*)op, key, klen);
+	return v != NULL && v->type == type ? v : NULL;
+}
+
+/* Replaces target with value, after forgetting the indices of what target held. */
+void lept_patch_replace(lept_patch_context* p, lept_value* target, lept_value* value) {
+	lept_patch_forget(p, target);
+	lept_move(target, value);
+}
+
+/* Moves value into place at path. */
+int lept_patch_add(lept_patch_context* p, lept_value* root, const char* path, size_t len, lept_value* value) {
+	lept_value* parent;
+	const char* key;
+	size_t tlen, index;
+	if (len == 0) {
+		lept_patch_replace(p, root, value);
+		return LEPT_PATCH_OK;
+	}
+	if ((parent = lept_pointer_resolve(p, root, path, len, 1, &tlen)) == NULL)
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	key = tlen > 0 ? p->c.stack : "";
+	if (parent->type == LEPT_OBJECT) {
+		if ((index = lept_patch_find(p, parent, key, tlen)) != LEPT_KEY_NOT_EXIST)
+			lept_patch_replace(p, &parent->u.o.m[index].v, value);
+		else
+			lept_move(lept_patch_append(p, parent, key, tlen), value);
+	}
+	else if (parent->type == LEPT_ARRAY && lept_pointer_index(key, tlen, parent->u.a.size, &index) && index <= parent->u.a.size)
+		lept_move(lept_insert_array_element(parent, index), value);
+	else
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	return LEPT_PATCH_OK;
+}
+
+/* Removes and frees the value at path. */
+int lept_patch_remove(lept_patch_context* p, lept_value* root, const char* path, size_t len) {
+	lept_value* parent;
+	size_t tlen, index;
+	if (len == 0 || (parent = lept_pointer_resolve(p, root, path, len, 1, &tlen)) == NULL)
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	if (parent->type == LEPT_OBJECT) {
+		if ((index = lept_patch_find(p, parent, tlen > 0 ? p->c.stack : "", tlen)) == LEPT_KEY_NOT_EXIST)
+			return LEPT_PATCH_PATH_NOT_FOUND;
+		lept_patch_forget(p, &parent->u.o.m[index].v);
+		lept_patch_unindex(p, parent, index);
+		lept_remove_object_value(parent, index);
+	}
+	else if (parent->type == LEPT_ARRAY && lept_pointer_index(p->c.stack, tlen, parent->u.a.size, &index) && index < parent->u.a.size) {
+		lept_patch_forget(p, &parent->u.a.e[index]);
+		lept_erase_array_element(parent, index, 1);
+	}
+	else
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	return LEPT_PATCH_OK;
+}
+
+/* Moves the value at from to path; when the add fails the value goes back where it was. */
+int lept_patch_move(lept_patch_context* p, lept_value* root, const lept_value* from, const lept_value* path) {
+	lept_value* parent;
+	lept_member held;
+	size_t tlen, index;
+	int ret;
+	if (from->u.s.len == 0) /* the root always exists, and can only be moved onto itself */
+		return path->u.s.len == 0 ? LEPT_PATCH_OK : LEPT_PATCH_INVALID_OPERATION;
+	if ((parent = lept_pointer_resolve(p, root, from->u.s.s, from->u.s.len, 1, &tlen)) == NULL)
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	if (parent->type == LEPT_OBJECT) {
+		if ((index = lept_patch_find(p, parent, tlen > 0 ? p->c.stack : "", tlen)) == LEPT_KEY_NOT_EXIST)
+			return LEPT_PATCH_PATH_NOT_FOUND;
+	}
+	else if (parent->type != LEPT_ARRAY || !lept_pointer_index(p->c.stack, tlen, parent->u.a.size, &index) || index >= parent->u.a.size)
+		return LEPT_PATCH_PATH_NOT_FOUND;
+	if (from->u.s.len == path->u.s.len && memcmp(from->u.s.s, path->u.s.s, path->u.s.len) == 0)
+		return LEPT_PATCH_OK;
+	/* a value cannot be moved into one of its own children */
+	if (from->u.s.len < path->u.s.len && path->u.s.s[from->u.s.len] == '/' && memcmp(from->u.s.s, path->u.s.s, from->u.s.len) == 0)
+		return LEPT_PATCH_INVALID_OPERATION;
+	/* detached without freeing, so the slot can be reopened; shrinking never reallocates parent */
+	if (parent->type == LEPT_OBJECT) {
+		lept_patch_unindex(p, parent, index);
+		held = parent->u.o.m[index];
+		memmove(&parent->u.o.m[index], &parent->u.o.m[index + 1], (parent->u.o.size - index - 1) * sizeof(lept_member));
+		parent->u.o.size--;
+	}
+	else {
+		held.k = NULL;
+		held.v = parent->u.a.e[index];
+		memmove(&parent->u.a.e[index], &parent->u.a.e[index + 1], (parent->u.a.size - index - 1) * sizeof(lept_value));
+		parent->u.a.size--;
+	}
+	/* a failed add has not touched the tree, so parent and index are still good */
+	if ((ret = lept_patch_add(p, root, path->u.s.s, path->u.s.len, &held.v)) != LEPT_PATCH_OK) {
+		if (parent->type == LEPT_OBJECT) {
+			lept_patch_drop(p, parent);
+			memmove(&parent->u.o.m[index + 1], &parent->u.o.m[index], (parent->u.o.size++ - index) * sizeof(lept_member));
+			parent->u.o.m[index] = held;
+		}
+		else {
+			memmove(&parent->u.a.e[index + 1], &parent->u.a.e[index], (parent->u.a.size++ - index) * sizeof(lept_value));
+			parent->u.a.e[index] = held.v;
+		}
+		return ret;
+	}
+	free(held.k);
+	return LEPT_PATCH_OK;
+}
+
+int lept_patch_operation(lept_patch_context* p, lept_value* root, const lept_value* op) {
+	const lept_value *name, *path, *from, *value;
+	lept_value* target;
+	lept_value temp;
+	int ret;
+	if (op->type != LEPT_OBJECT
+		|| (name = lept_patch_member(op, "op", 2, LEPT_STRING)) == NULL
+		|| (path = lept_patch_member(op, "path", 4, LEPT_STRING)) == NULL)
+		return LEPT_PATCH_INVALID_OPERATION;
+	value = lept_find_object_value((lept_value*)op, "value", 5);
+	from = lept_patch_member(op, "from", 4, LEPT_STRING);
+	lept_init(&temp);
+#define LEPT_OP_IS(literal) (name->u.s.len == sizeof(literal) - 1 && memcmp(name->u.s.s, literal, sizeof(literal) - 1) == 0)
+	if (LEPT_OP_IS("add") || LEPT_OP_IS("replace") || LEPT_OP_IS("test")) {
+		if (value == NULL)
+			return LEPT_PATCH_INVALID_OPERATION;
+		if (LEPT_OP_IS("add")) {
+			lept_copy(&temp, value);
+			ret = lept_patch_add(p, root, path->u.s.s, path->u.s.len, &temp);
+		}
+		else if ((target = lept_pointer_resolve(p, root, path->u.s.s, path->u.s.len, 0, NULL)) == NULL)
+			ret = LEPT_PATCH_PATH_NOT_FOUND;
+		else if (LEPT_OP_IS("replace")) {
+			lept_copy(&temp, value);
+			lept_patch_replace(p, target, &temp);
+			ret = LEPT_PATCH_OK;
+		}
+		else
+			ret = lept_is_equal(target, value) ? LEPT_PATCH_OK : LEPT_PATCH_TEST_FAILED;
+	}
+	else if (LEPT_OP_IS("remove"))
+		ret = lept_patch_remove(p, root, path->u.s.s, path->u.s.len);
+	else if (LEPT_OP_IS("move") || LEPT_OP_IS("copy")) {
+		if (from == NULL)
+			return LEPT_PATCH_INVALID_OPERATION;
+		if (LEPT_OP_IS("move"))
+			ret = lept_patch_move(p, root, from, path);
+		else if ((target = lept_pointer_resolve(p, root, from->u.s.s, from->u.s.len, 0, NULL)) == NULL)
+			ret = LEPT_PATCH_PATH_NOT_FOUND;
+		else {
+			lept_copy(&temp, target);
+			ret = lept_patch_add(p, root, path->u.s.s, path->u.s.len, &temp);
+		}
+	}
+	else
+		ret = LEPT_PATCH_INVALID_OPERATION;
+#undef LEPT_OP_IS
+	lept_free(&temp);
+	return ret;
+}
+
+int lept_apply_patch(lept_value* v, const lept_value* patch) {
+	lept_patch_context p;
+	std::unordered_map<const lept_member*, lept_key_index>::iterator it;
+	size_t i;
+	int ret = LEPT_PATCH_OK;
+	assert(v != NULL && patch != NULL);
+	if (patch->type != LEPT_ARRAY)
+		return LEPT_PATCH_INVALID_OPERATION;
+	p.c.stack = NULL;
+	p.c.size = p.c.top = 0;
+	for (i = 0; i < patch->u.a.size && ret == LEPT_PATCH_OK; i++)
+		ret = lept_patch_operation(&p, v, &patch->u.a.e[i]);
+	for (it = p.indices.begin(); it != p.indices.end(); ++it)
+		free(it->second.slots);
+	free(p.c.stack);
+	return ret;
+}
+
+/*----------------------reformat--------------------------*/
+#ifndef LEPT_REFORMAT_FLUSH_SIZE
+#define LEPT_REFORMAT_FLUSH_SIZE 4096
+#endif
+
+struct lept_reformat_context
+{
+	lept_context c;   /* input position and the string scanner's scratch stack */
+	lept_context out; /* output not yet handed to the sink */
+	lept_sink sink;
+	void* user;
+	int indent;       /* < 0 when minifying */
+	int emit;         /* 0 when only validating, or when writing CBOR */
+	int cbor;         /* writes CBOR into out instead, never flushed to a sink */
+	size_t depth;
+};
+
+void lept_reformat_put(lept_reformat_context* r, const char* s, size_t len) {
+	if (!r->emit || len == 0)
+		return;
+	PUTS(&r->out, s, len);
+	if (r->sink != NULL && r->out.top >= LEPT_REFORMAT_FLUSH_SIZE) {
+		r->sink(r->user, r->out.stack, r->out.top);
+		r->out.top = 0;
+	}
+}
+
+void lept_reformat_newline(lept_reformat_context* r) {
+	size_t n;
+	if (!r->emit || r->indent < 0)
+		return;
+	n = r->depth * r->indent;
+	PUTC(&r->out, '\n');
+	if (n > 0)
+		memset(lept_context_push(&r->out, n), ' ', n);
+}
+
+int lept_reformat_container(lept_reformat_context* r);
+
+/* Scalars go through the parser's own checks and are copied from the input as written. */
+int lept_reformat_value(lept_reformat_context* r) {
+	const char* start = r->c.json;
+	lept_value scratch;
+	char* str;
+	size_t len;
+	int ret;
+	switch (*r->c.json) {
+	case 'n':  ret = lept_parse_literal(&r->c, &scratch, "null", LEPT_NULL); break;
+	case 't':  ret = lept_parse_literal(&r->c, &scratch, "true", LEPT_TRUE); break;
+	case 'f':  ret = lept_parse_literal(&r->c, &scratch, "false", LEPT_FALSE); break;
+	case '\"': ret = lept_parse_string_raw(&r->c, &str, &len); break;
+	case '[':
+	case '{':  return lept_reformat_container(r);
+	case '\0': return LEPT_PARSE_EXPECT_VALUE;
+	default:   ret = lept_parse_number(&r->c, &scratch); break;
+	}
+	if (ret != LEPT_PARSE_OK)
+		return ret;
+	if (!r->cbor)
+		lept_reformat_put(r, start, r->c.json - start);
+	else if (*start == '"') {
+		lept_cbor_put_head(&r->out, LEPT_CBOR_TEXT, len);
+		if (len > 0)
+			PUTS(&r->out, str, len);
+	}
+	else if (*start == 'n' || *start == 't' || *start == 'f')
+		PUTC(&r->out, (char)(*start == 'n' ? LEPT_CBOR_NULL : *start == 't' ? LEPT_CBOR_TRUE : LEPT_CBOR_FALSE));
+	else
+		lept_cbor_put_number(&r->out, scratch.u.n);
+	return LEPT_PARSE_OK;
+}
+
+/* Mirrors lept_parse_array and lept_parse_object, including which error each one reports. */
+int lept_reformat_container(lept_reformat_context* r) {
+	const char* start;
+	char* str;
+	size_t len, head = r->out.top, count = 0;
+	int ret, is_array = *r->c.json == '[';
+	char close = is_array ? ']' : '}';
+	/* CBOR heads come before the items, so an 8-byte count is reserved and filled in at the end */
+	if (r->cbor)
+		lept_cbor_write_head((unsigned char*)lept_context_push(&r->out, 9), is_array ? LEPT_CBOR_ARRAY : LEPT_CBOR_MAP, 0, 8);
+	lept_reformat_put(r, r->c.json++, 1);
+	lept_parse_whitespace(&r->c);
+	if (*r->c.json == close) {
+		lept_reformat_put(r, r->c.json++, 1);
+		return LEPT_PARSE_OK;
+	}
+	r->depth++;
+	for (;;) {
+		lept_reformat_newline(r);
+		if (is_array) {
+			lept_parse_whitespace(&r->c);
+		}
+		else {
+			start = r->c.json;
+			if (*r->c.json != '"' || lept_parse_string_raw(&r->c, &str, &len) != LEPT_PARSE_OK)
+				return LEPT_PARSE_MISS_KEY;
+			lept_reformat_put(r, start, r->c.json - start);
+			if (r->cbor) {
+				lept_cbor_put_head(&r->out, LEPT_CBOR_TEXT, len);
+				if (len > 0)
+					PUTS(&r->out, str, len);
+			}
+			lept_parse_whitespace(&r->c);
+			if (*r->c.json != ':')
+				return LEPT_PARSE_MISS_COLON;
+			r->c.json++;
+			lept_reformat_put(r, ": ", r->indent < 0 ? 1 : 2);
+			lept_parse_whitespace(&r->c);
+		}
+		if ((ret = lept_reformat_value(r)) != LEPT_PARSE_OK)
+			return ret;
+		count++;
+		lept_parse_whitespace(&r->c);
+		if (*r->c.json == ',') {
+			lept_reformat_put(r, r->c.json++, 1);
+			if (!is_array)
+				lept_parse_whitespace(&r->c);
+		}
+		else if (*r->c.json == close) {
+			r->depth--;
+			lept_reformat_newline(r);
+			lept_reformat_put(r, r->c.json++, 1);
+			if (r->cbor)
+				lept_cbor_write_head((unsigned char*)r->out.stack + head, is_array ? LEPT_CBOR_ARRAY : LEPT_CBOR_MAP, count, 8);
+			return LEPT_PARSE_OK;
+		}
+		else
+			return is_array ? LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET : LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET;
+	}
+}
+
+/* The reformat context owns out.stack afterwards; buffer callers take it over on success. */
+int lept_reformat_run(lept_reformat_context* r, const char* json) {
+	int ret;
+	r->c.json = json;
+	r->c.stack = NULL;
+	r->c.size = r->c.top = 0;
+	r->c.path = NULL;
+	r->c.path_len = 0;
+	r->out.stack = NULL;
+	r->out.size = r->out.top = 0;
+	r->depth = 0;
+	lept_parse_whitespace(&r->c);
+	if ((ret = lept_reformat_value(r)) == LEPT_PARSE_OK) {
+		lept_parse_whitespace(&r->c);
+		if (*r->c.json != '\0')
+			ret = LEPT_PARSE_ROOT_NOT_SINGULAR;
+	}
+	free(r->c.stack);
+	return ret;
+}
+
+int lept_reformat(const char* json, int indent, lept_sink sink, void* user) {
+	lept_reformat_context r;
+	int ret;
+	assert(json != NULL);
+	r.sink = sink;
+	r.user = user;
+	r.indent = indent;
+	r.emit = sink != NULL;
+	r.cbor = 0;
+	ret = lept_reformat_run(&r, json);
+	if (ret == LEPT_PARSE_OK && r.out.top > 0)
+		sink(user, r.out.stack, r.out.top);
+	free(r.out.stack);
+	return ret;
+}
+
+int lept_validate(const char* json) {
+	return lept_reformat(json, -1, NULL, NULL);
+}
+
+int lept_reformat_to_buffer(const char* json, int indent, char** out, size_t* length) {
+	lept_reformat_context r;
+	int ret;
+	assert(json != NULL && out != NULL);
+	r.sink = NULL;
+	r.user = NULL;
+	r.indent = indent;
+	r.emit = 1;
+	r.cbor = 0;
+	if ((ret = lept_reformat_run(&r, json)) != LEPT_PARSE_OK) {
+		free(r.out.stack);
+		*out = NULL;
+		if (length)
+			*length = 0;
+		return ret;
+	}
+	if (length)
+		*length = r.out.top;
+	PUTC(&r.out, '\0');
+	*out = r.out.stack;
+	return LEPT_PARSE_OK;
+}
+
+int lept_minify(const char* json, char** out, size_t* length) {
+	return lept_reformat_to_buffer(json, -1, out, length);
+}
+
+int lept_prettify(const char* json, char** out, size_t* length) {
+	return lept_reformat_to_buffer(json, 4, out, length);
+}
+
+/*
+ * Rewrites every container head in its shortest form, in place. Heads only shrink, so
+ * the write position never passes the read position; all other items are copied as is.
+ */
+size_t lept_cbor_shrink_heads(char* cbor, size_t length) {
+	lept_cbor_reader rd;
+	unsigned char* w = (unsigned char*)cbor;
+	const unsigned char* run; /* items since the last container head, moved in one go */
+	int major, bytes;
+	uint64_t n;
+	rd.p = run = (const unsigned char*)cbor;
+	rd.end = rd.p + length;
+	while (rd.p < rd.end) {
+		const unsigned char* start = rd.p;
+		if (lept_cbor_get_head(&rd, &major, &n) != LEPT_PARSE_OK) {
+			assert(0 && "lept_json_to_cbor wrote a malformed head");
+			break;
+		}
+		if (major == LEPT_CBOR_TEXT)
+			rd.p += n;
+		else if (major == LEPT_CBOR_ARRAY || major == LEPT_CBOR_MAP) {
+			memmove(w, run, start - run);
+			w += start - run;
+			bytes = lept_cbor_head_bytes(n);
+			lept_cbor_write_head(w, major, n, bytes);
+			w += 1 + bytes;
+			run = rd.p;
+		}
+	}
+	memmove(w, run, rd.p - run);
+	return w + (rd.p - run) - (unsigned char*)cbor;
+}
+
+/* Transcodes in one pass over the text; no lept_value is built. */
+int lept_json_to_cbor(const char* json, char** cbor, size_t* length) {
+	lept_reformat_context r;
+	int ret;
+	assert(json != NULL && cbor != NULL && length != NULL);
+	r.sink = NULL;
+	r.user = NULL;
+	r.indent = -1;
+	r.emit = 0;
+	r.cbor = 1;
+	*cbor = NULL;
+	*length = 0;
+	if ((ret = lept_reformat_run(&r, json)) != LEPT_PARSE_OK) {
+		free(r.out.stack);
+		return ret;
+	}
+	*length = lept_cbor_shrink_heads(r.out.stack, r.out.top);
+	*cbor = r.out.stack;
+	return LEPT_PARSE_OK;
+}
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <errno.h>   /* errno, ERANGE */
 #include <math.h>    /* HUGE_VAL */
+#include <stdint.h>  /* uint64_t */
 
 #define EXPECT(c,ch) do { assert(*c->json == ch); c->json++; }while(0)
 
@@ -15,8 +16,8 @@ struct lept_value
 {
 	union
 	{
-		struct { lept_member* m; size_t size; } o;/* object */
-		struct { lept_value* e; size_t size; }a; /* array */
+		struct { lept_member* m; size_t size, capacity; } o;/* object */
+		struct { lept_value* e; size_t size, capacity; }a; /* array */
 		struct
 		{
 			char* s;
@@ -45,7 +46,8 @@ enum {
 	LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET,
 	LEPT_PARSE_MISS_KEY,
 	LEPT_PARSE_MISS_COLON,
-	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET
+	LEPT_PARSE_MISS_COMMA_OR_CURLY_BRACKET,
+	LEPT_PARSE_INVALID_CBOR
 };
 
 struct lept_context
@@ -53,11 +55,26 @@ struct lept_context
 	const char* json;
 	char* stack;
 	size_t size, top;
+	char* path;      /* JSON Pointer of a parse failure, only built on error */
+	size_t path_len;
+};
+
+struct lept_parse_result
+{
+	int code;
+	size_t offset;       /* byte offset of the failure in the input */
+	size_t line, column; /* 1-based, counted only when the parse fails */
+	char* path;          /* JSON Pointer to the failing value, "" for the root; NULL on success */
 };
 
 #define lept_init(v) do { (v)->type = LEPT_NULL; } while(0)
 
 int lept_parse(lept_value* v, const char* json);
+int lept_parse_ex(lept_value* v, const char* json, lept_parse_result* result);
+void lept_free_parse_result(lept_parse_result* result);
+/* splits a top-level array/object across threads (0 = hardware concurrency), same results as lept_parse */
+int lept_parse_parallel(lept_value* v, const char* json, unsigned int threads);
+int lept_parse_parallel_ex(lept_value* v, const char* json, unsigned int threads, lept_parse_result* result);
 
 void lept_free(lept_value* v);
 
@@ -75,12 +92,90 @@ const char* lept_get_string(const lept_value* v);
 size_t lept_get_string_length(const lept_value* v);
 void lept_set_string(lept_value* v, const char* s, size_t len);
 
+void lept_set_array(lept_value* v, size_t capacity);
 size_t lept_get_array_size(const lept_value* v);
+size_t lept_get_array_capacity(const lept_value* v);
+void lept_reserve_array(lept_value* v, size_t capacity);
+void lept_shrink_array(lept_value* v);
+void lept_clear_array(lept_value* v);
 lept_value* lept_get_array_element(const lept_value* v, size_t index);
+lept_value* lept_pushback_array_element(lept_value* v);
+void lept_popback_array_element(lept_value* v);
+lept_value* lept_insert_array_element(lept_value* v, size_t index);
+void lept_erase_array_element(lept_value* v, size_t index, size_t count);
 
+#define LEPT_KEY_NOT_EXIST ((size_t)-1)
+
+void lept_set_object(lept_value* v, size_t capacity);
 size_t lept_get_object_size(const lept_value* v);
+size_t lept_get_object_capacity(const lept_value* v);
+void lept_reserve_object(lept_value* v, size_t capacity);
+void lept_shrink_object(lept_value* v);
+void lept_clear_object(lept_value* v);
 const char* lept_get_object_key(const lept_value* v, size_t index);
 size_t lept_get_object_key_length(const lept_value* v, size_t index);
 lept_value* lept_get_object_value(const lept_value* v, size_t index);
+size_t lept_find_object_index(const lept_value* v, const char* key, size_t klen);
+lept_value* lept_find_object_value(lept_value* v, const char* key, size_t klen);
+lept_value* lept_set_object_value(lept_value* v, const char* key, size_t klen);
+void lept_remove_object_value(lept_value* v, size_t index);
+
+/* move and swap transfer ownership of the blocks, only copy duplicates them; copy and move accept src inside dst */
+void lept_copy(lept_value* dst, const lept_value* src);
+void lept_move(lept_value* dst, lept_value* src);
+void lept_swap(lept_value* lhs, lept_value* rhs);
+
+/* object member order is ignored by both */
+int lept_is_equal(const lept_value* lhs, const lept_value* rhs);
+uint64_t lept_hash(const lept_value* v);
+
+enum {
+	LEPT_PATCH_OK = 0,
+	LEPT_PATCH_INVALID_OPERATION,
+	LEPT_PATCH_PATH_NOT_FOUND,
+	LEPT_PATCH_TEST_FAILED
+};
+
+/* JSON Patch (RFC 6902); a failed patch leaves the operations before the failing one applied */
+void lept_diff(const lept_value* a, const lept_value* b, lept_value* patch);
+int lept_apply_patch(lept_value* v, const lept_value* patch);
+
+/*
+ * An immutable, reference-counted tree that any number of threads may read
+ * without locking. The key index is built once at creation, never lazily.
+ */
+struct lept_document;
+struct lept_document_slot;
+
+lept_document* lept_document_create(lept_value* v); /* takes v over, leaving it null */
+int lept_document_parse(lept_document** doc, const char* json);
+lept_document* lept_document_retain(lept_document* doc);
+void lept_document_release(lept_document* doc);
+const lept_value* lept_document_get_root(const lept_document* doc);
+const lept_value* lept_document_find_object_value(const lept_document* doc, const lept_value* object, const char* key, size_t klen);
+
+/* Copy-on-write publication: acquire never blocks, publish waits for in-flight acquires only. */
+lept_document_slot* lept_document_slot_create(lept_document* doc);
+void lept_document_slot_destroy(lept_document_slot* slot);
+lept_document* lept_document_slot_acquire(lept_document_slot* slot);
+void lept_document_slot_publish(lept_document_slot* slot, lept_document* doc);
+
+/*
+ * Text-to-text passes over the same grammar as lept_parse, returning the same
+ * error codes, without building any lept_value. indent < 0 minifies, otherwise
+ * each level is indented by that many spaces. A NULL sink only validates;
+ * output already handed to a sink stays delivered if a later byte fails.
+ */
+typedef void (*lept_sink)(void* user, const char* s, size_t len);
+int lept_reformat(const char* json, int indent, lept_sink sink, void* user);
+int lept_validate(const char* json);
+int lept_minify(const char* json, char** out, size_t* length);
+int lept_prettify(const char* json, char** out, size_t* length);
+
+/* CBOR (RFC 7049) binary encoding, containers always carry their element count */
+char* lept_encode_cbor(const lept_value* v, size_t* length);
+int lept_decode_cbor(lept_value* v, const char* cbor, size_t length);
+int lept_json_to_cbor(const char* json, char** cbor, size_t* length);
+int lept_cbor_to_json(const char* cbor, size_t length, char** json, size_t* json_length);
 
 #endif // !LEPTJSON_H__
@@ -5,10 +5,12 @@
 
 #pragma once
 
+#ifdef _MSC_VER
 #include "targetver.h"
+#include <tchar.h>
+#endif
 
 #include <stdio.h>
-#include <tchar.h>
 
 
 
@@ -4,8 +4,13 @@
 
 #define _CRTDBG_MAP_ALLOC
 #include <stdlib.h>
+#ifdef _MSC_VER
 #include <crtdbg.h>
+#endif
 #include <string.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 
 static int main_ret = 0;
@@ -221,6 +226,39 @@ static void test_parse_miss_comma_or_curly_bracket() {
 
 
 /*----------------------------------------------------*/
+#define TEST_ERROR_POSITION(error, expect_offset, expect_line, expect_column, expect_path, json)\
+    do {\
+        lept_value v;\
+        lept_parse_result r;\
+        EXPECT_EQ_INT(error, lept_parse_ex(&v, json, &r));\
+        EXPECT_EQ_INT(error, r.code);\
+        EXPECT_EQ_SIZE_T(expect_offset, r.offset);\
+        EXPECT_EQ_SIZE_T(expect_line, r.line);\
+        EXPECT_EQ_SIZE_T(expect_column, r.column);\
+        EXPECT_EQ_STRING(expect_path, r.path, strlen(r.path));\
+        lept_free_parse_result(&r);\
+    } while(0)
+
+static void test_parse_error_position() {
+	lept_value v;
+	lept_parse_result r;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse_ex(&v, "[1, 2]", &r));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, r.code);
+	EXPECT_TRUE(r.path == NULL);
+	lept_free(&v);
+
+	TEST_ERROR_POSITION(LEPT_PARSE_EXPECT_VALUE, 2, 1, 3, "", "  ");
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_VALUE, 3, 1, 4, "", "nul");
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_VALUE, 2, 1, 3, "", "1.e");
+	TEST_ERROR_POSITION(LEPT_PARSE_ROOT_NOT_SINGULAR, 5, 1, 6, "", "null x");
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_STRING_ESCAPE, 3, 1, 4, "", "\"ab\\v\"");
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_STRING_CHAR, 2, 1, 3, "", "\"a\x01\"");
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_QUOTATION_MARK, 4, 1, 5, "", "\"abc");
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_COMMA_OR_SQUARE_BRACKET, 7, 3, 3, "", "[\n1,\n2 3]");
+	TEST_ERROR_POSITION(LEPT_PARSE_INVALID_VALUE, 15, 2, 12, "/1/a~1b~0", "[0,\n{\"a/b~\":tru}]");
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_COLON, 15, 1, 16, "/k/2", "{\"k\":[0,1,{\"x\" 1}]}");
+	TEST_ERROR_POSITION(LEPT_PARSE_MISS_KEY, 7, 1, 8, "", "{\"a\":1,");
+}
 
 static void test_parse_invalid_value() {
 	TEST_ERROR(LEPT_PARSE_INVALID_VALUE, "nul");
@@ -283,6 +321,809 @@ static void test_access_string() {
 	EXPECT_EQ_STRING("Hello", lept_get_string(&v), lept_get_string_length(&v));
 	lept_free(&v);
 }
+static void test_access_array() {
+	lept_value a, e;
+	size_t i, j;
+
+	lept_init(&a);
+
+	for (j = 0; j <= 5; j += 5) {
+		lept_set_array(&a, j);
+		EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+		EXPECT_EQ_SIZE_T(j, lept_get_array_capacity(&a));
+		for (i = 0; i < 10; i++)
+			lept_set_number(lept_pushback_array_element(&a), i);
+
+		EXPECT_EQ_SIZE_T(10, lept_get_array_size(&a));
+		for (i = 0; i < 10; i++)
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+	}
+
+	lept_popback_array_element(&a);
+	EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+	for (i = 0; i < 9; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+	lept_erase_array_element(&a, 4, 0);
+	EXPECT_EQ_SIZE_T(9, lept_get_array_size(&a));
+	for (i = 0; i < 9; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+	lept_erase_array_element(&a, 8, 1);
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+	lept_erase_array_element(&a, 0, 2);
+	EXPECT_EQ_SIZE_T(6, lept_get_array_size(&a));
+	for (i = 0; i < 6; i++)
+		EXPECT_EQ_DOUBLE((double)i + 2, lept_get_number(lept_get_array_element(&a, i)));
+
+	for (i = 0; i < 2; i++)
+		lept_set_number(lept_insert_array_element(&a, i), (double)i);
+
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+	EXPECT_TRUE(lept_get_array_capacity(&a) > 8);
+	lept_shrink_array(&a);
+	EXPECT_EQ_SIZE_T(8, lept_get_array_capacity(&a));
+	EXPECT_EQ_SIZE_T(8, lept_get_array_size(&a));
+	for (i = 0; i < 8; i++)
+		EXPECT_EQ_DOUBLE((double)i, lept_get_number(lept_get_array_element(&a, i)));
+
+	lept_init(&e);
+	lept_set_string(&e, "Hello", 5);
+	lept_move(lept_pushback_array_element(&a), &e);     /* Test if element is freed */
+	lept_free(&e);
+
+	i = lept_get_array_capacity(&a);
+	lept_clear_array(&a);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+	EXPECT_EQ_SIZE_T(i, lept_get_array_capacity(&a));   /* capacity remains unchanged */
+	lept_shrink_array(&a);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_capacity(&a));
+
+	lept_clear_array(&a);   /* no elements and no buffer */
+	lept_erase_array_element(&a, 0, 0);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&a));
+
+	lept_free(&a);
+}
+
+static void test_access_object() {
+	lept_value o, v, *pv;
+	size_t i, j, index;
+
+	lept_init(&o);
+
+	for (j = 0; j <= 5; j += 5) {
+		lept_set_object(&o, j);
+		EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+		EXPECT_EQ_SIZE_T(j, lept_get_object_capacity(&o));
+		for (i = 0; i < 10; i++) {
+			char key[2] = "a";
+			key[0] += (char)i;
+			lept_init(&v);
+			lept_set_number(&v, (double)i);
+			lept_move(lept_set_object_value(&o, key, 1), &v);
+			lept_free(&v);
+		}
+		EXPECT_EQ_SIZE_T(10, lept_get_object_size(&o));
+		for (i = 0; i < 10; i++) {
+			char key[] = "a";
+			key[0] += (char)i;
+			index = lept_find_object_index(&o, key, 1);
+			EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+			pv = lept_get_object_value(&o, index);
+			EXPECT_EQ_DOUBLE((double)i, lept_get_number(pv));
+		}
+	}
+
+	index = lept_find_object_index(&o, "j", 1);
+	EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+	lept_remove_object_value(&o, index);
+	index = lept_find_object_index(&o, "j", 1);
+	EXPECT_TRUE(index == LEPT_KEY_NOT_EXIST);
+	EXPECT_EQ_SIZE_T(9, lept_get_object_size(&o));
+
+	index = lept_find_object_index(&o, "a", 1);
+	EXPECT_TRUE(index != LEPT_KEY_NOT_EXIST);
+	lept_remove_object_value(&o, index);
+	index = lept_find_object_index(&o, "a", 1);
+	EXPECT_TRUE(index == LEPT_KEY_NOT_EXIST);
+	EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+
+	EXPECT_TRUE(lept_get_object_capacity(&o) > 8);
+	lept_shrink_object(&o);
+	EXPECT_EQ_SIZE_T(8, lept_get_object_capacity(&o));
+	EXPECT_EQ_SIZE_T(8, lept_get_object_size(&o));
+	for (i = 0; i < 8; i++) {
+		char key[] = "a";
+		key[0] += (char)(i + 1);
+		EXPECT_EQ_DOUBLE((double)i + 1, lept_get_number(lept_get_object_value(&o, lept_find_object_index(&o, key, 1))));
+	}
+
+	lept_set_string(&v, "Hello", 5);
+	lept_move(lept_set_object_value(&o, "World", 5), &v); /* Test if element is freed */
+	lept_free(&v);
+
+	pv = lept_find_object_value(&o, "World", 5);
+	EXPECT_TRUE(pv != NULL);
+	EXPECT_EQ_STRING("Hello", lept_get_string(pv), lept_get_string_length(pv));
+
+	i = lept_get_object_capacity(&o);
+	lept_clear_object(&o);
+	EXPECT_EQ_SIZE_T(0, lept_get_object_size(&o));
+	EXPECT_EQ_SIZE_T(i, lept_get_object_capacity(&o)); /* capacity remains unchanged */
+	lept_shrink_object(&o);
+	EXPECT_EQ_SIZE_T(0, lept_get_object_capacity(&o));
+
+	lept_free(&o);
+}
+
+static void test_copy_move_swap() {
+	lept_value v1, v2, v3;
+	lept_init(&v1);
+	lept_parse(&v1, "{\"t\":true,\"f\":false,\"n\":null,\"d\":1.5,\"a\":[1,2,3]}");
+	lept_init(&v2);
+	lept_copy(&v2, &v1);
+	EXPECT_EQ_SIZE_T(5, lept_get_object_size(&v2));
+	EXPECT_EQ_DOUBLE(1.5, lept_get_number(lept_find_object_value(&v2, "d", 1)));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(lept_find_object_value(&v2, "a", 1)));
+	EXPECT_TRUE(lept_find_object_value(&v2, "a", 1) != lept_find_object_value(&v1, "a", 1));
+
+	lept_init(&v3);
+	lept_move(&v3, &v2);
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v2));
+	EXPECT_EQ_SIZE_T(5, lept_get_object_size(&v3));
+
+	lept_set_string(&v2, "Hello", 5);
+	lept_swap(&v2, &v3);
+	EXPECT_EQ_STRING("Hello", lept_get_string(&v3), lept_get_string_length(&v3));
+	EXPECT_EQ_SIZE_T(5, lept_get_object_size(&v2));
+
+	/* copying a child over its own parent */
+	lept_copy(&v2, lept_find_object_value(&v2, "a", 1));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(&v2));
+	lept_copy(&v2, lept_get_array_element(&v2, 1));
+	EXPECT_EQ_DOUBLE(2.0, lept_get_number(&v2));
+	lept_free(&v3);
+	lept_parse(&v3, "[\"Hello\"]");
+	lept_copy(&v3, lept_get_array_element(&v3, 0));
+	EXPECT_EQ_STRING("Hello", lept_get_string(&v3), lept_get_string_length(&v3));
+	lept_free(&v3);
+	lept_parse(&v3, "[[1,2,3]]");
+	lept_move(&v3, lept_get_array_element(&v3, 0));
+	EXPECT_EQ_SIZE_T(3, lept_get_array_size(&v3));
+	EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_get_array_element(&v3, 2)));
+	lept_free(&v1);
+	lept_free(&v2);
+	lept_free(&v3);
+}
+
+/*--------------------parallel parse-------------------*/
+/* Both modes must agree on the code and, for a failure, on where it is. */
+static int parse_serial_and_parallel(const char* json, lept_value* serial, lept_value* parallel) {
+	lept_parse_result s, p;
+	int ret = lept_parse_ex(serial, json, &s);
+	EXPECT_EQ_INT(ret, lept_parse_parallel_ex(parallel, json, 4, &p));
+	EXPECT_EQ_INT(s.code, p.code);
+	EXPECT_EQ_SIZE_T(s.offset, p.offset);
+	EXPECT_EQ_SIZE_T(s.line, p.line);
+	EXPECT_EQ_SIZE_T(s.column, p.column);
+	if (ret == LEPT_PARSE_OK)
+		EXPECT_TRUE(s.path == NULL && p.path == NULL);
+	else
+		EXPECT_TRUE(s.path != NULL && p.path != NULL && strcmp(s.path, p.path) == 0);
+	lept_free_parse_result(&s);
+	lept_free_parse_result(&p);
+	return ret;
+}
+
+/* The CBOR encoding is deterministic, so equal bytes means equal trees. */
+static void expect_same_tree(const lept_value* expect, const lept_value* actual) {
+	size_t expect_length, actual_length;
+	char* e = lept_encode_cbor(expect, &expect_length);
+	char* a = lept_encode_cbor(actual, &actual_length);
+	EXPECT_EQ_SIZE_T(expect_length, actual_length);
+	EXPECT_TRUE(expect_length == actual_length && memcmp(e, a, expect_length) == 0);
+	free(e);
+	free(a);
+}
+
+#define TEST_PARALLEL_ERROR(json)\
+    do {\
+        lept_value serial, parallel;\
+        EXPECT_TRUE(parse_serial_and_parallel(json, &serial, &parallel) != LEPT_PARSE_OK);\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&parallel));\
+    } while(0)
+
+static void test_parse_parallel() {
+	static const char* items[] = { "null", "true", "-1.5e3", "\"a,]}\\\"b\"", "[1,[2,{}]]", "{\"k\":[\"}\"]}" };
+	lept_value serial, parallel;
+	char json[4096], *p;
+	size_t i;
+
+	for (p = json, i = 0; i < 100; i++)
+		p += snprintf(p, json + sizeof(json) - p, "%s %s", i ? "," : " [", items[i % 6]);
+	snprintf(p, json + sizeof(json) - p, " ] ");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, parse_serial_and_parallel(json, &serial, &parallel));
+	EXPECT_EQ_SIZE_T(100, lept_get_array_size(&parallel));
+	expect_same_tree(&serial, &parallel);
+	lept_free(&serial);
+	lept_free(&parallel);
+
+	for (p = json, i = 0; i < 100; i++)
+		p += snprintf(p, json + sizeof(json) - p, "%s\"k%d\" : %s", i ? "," : "{", (int)i, items[i % 6]);
+	snprintf(p, json + sizeof(json) - p, "}");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, parse_serial_and_parallel(json, &serial, &parallel));
+	EXPECT_EQ_SIZE_T(100, lept_get_object_size(&parallel));
+	expect_same_tree(&serial, &parallel);
+	lept_free(&serial);
+	lept_free(&parallel);
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, parse_serial_and_parallel("[ ]", &serial, &parallel));
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&parallel));
+	lept_free(&serial);
+	lept_free(&parallel);
+
+	TEST_PARALLEL_ERROR("[1,2,3,4,]");
+	TEST_PARALLEL_ERROR("[1,2,3,4,5 6]");
+	TEST_PARALLEL_ERROR("[1,2,3,4,5}");
+	TEST_PARALLEL_ERROR("[1,2,3,4,5] x");
+	TEST_PARALLEL_ERROR("[1,2,3,4,\"5]");
+	TEST_PARALLEL_ERROR("[1,2,3,4,[5]");
+	TEST_PARALLEL_ERROR("[\"\\v\",2,3,4,5]");
+	TEST_PARALLEL_ERROR("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\"}");
+	TEST_PARALLEL_ERROR("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,5:5}");
+	TEST_PARALLEL_ERROR("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":1e309}");
+}
+
+/*------------------equality / hash-------------------*/
+#define TEST_EQUAL(json1, json2, equality) \
+    do {\
+        lept_value v1, v2;\
+        lept_init(&v1);\
+        lept_init(&v2);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, json1));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, json2));\
+        EXPECT_EQ_INT(equality, lept_is_equal(&v1, &v2));\
+        if (equality)\
+            EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));\
+        lept_free(&v1);\
+        lept_free(&v2);\
+    } while(0)
+
+static void test_equal() {
+	TEST_EQUAL("true", "true", 1);
+	TEST_EQUAL("true", "false", 0);
+	TEST_EQUAL("false", "false", 1);
+	TEST_EQUAL("null", "null", 1);
+	TEST_EQUAL("null", "0", 0);
+	TEST_EQUAL("123", "123", 1);
+	TEST_EQUAL("123", "456", 0);
+	TEST_EQUAL("0", "-0", 1);
+	TEST_EQUAL("\"abc\"", "\"abc\"", 1);
+	TEST_EQUAL("\"abc\"", "\"abcd\"", 0);
+	TEST_EQUAL("[]", "[]", 1);
+	TEST_EQUAL("[]", "null", 0);
+	TEST_EQUAL("[1,2,3]", "[1,2,3]", 1);
+	TEST_EQUAL("[1,2,3]", "[1,2,3,4]", 0);
+	TEST_EQUAL("[1,2,3]", "[3,2,1]", 0);
+	TEST_EQUAL("[[]]", "[[]]", 1);
+	TEST_EQUAL("{}", "{}", 1);
+	TEST_EQUAL("{}", "null", 0);
+	TEST_EQUAL("{}", "[]", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"b\":2,\"a\":1}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":3}", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"b\":2,\"c\":3}", 0);
+	TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":{}}}}", 1);
+	TEST_EQUAL("{\"a\":{\"b\":{\"c\":{}}}}", "{\"a\":{\"b\":{\"c\":[]}}}", 0);
+	TEST_EQUAL("{\"\":\"\"}", "{\"\":\"\"}", 1);
+	/* duplicate keys pair up in order, whichever side is on the left */
+	TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"a\":1}", 1);
+	TEST_EQUAL("{\"a\":{},\"b\":0,\"a\":[]}", "{\"a\":{},\"b\":0,\"a\":[]}", 1);
+	TEST_EQUAL("{\"a\":1,\"a\":1}", "{\"a\":1,\"b\":2}", 0);
+	TEST_EQUAL("{\"a\":1,\"b\":2}", "{\"a\":1,\"a\":1}", 0);
+	TEST_EQUAL("{\"b\":1,\"a\":1,\"a\":2}", "{\"a\":1,\"a\":2,\"b\":1}", 1);
+	TEST_EQUAL("{\"a\":1,\"a\":2,\"b\":1}", "{\"b\":1,\"a\":1,\"a\":2}", 1);
+	TEST_EQUAL("{\"a\":1,\"a\":2}", "{\"a\":2,\"a\":1}", 0);
+	TEST_EQUAL("{\"a\":2,\"a\":1}", "{\"a\":1,\"a\":2}", 0);
+	/* large enough to be matched through a key index */
+	TEST_EQUAL("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":[8]}",
+	           "{\"h\":[8],\"g\":7,\"f\":6,\"e\":5,\"d\":4,\"c\":3,\"b\":2,\"a\":1}", 1);
+	TEST_EQUAL("{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":[8]}",
+	           "{\"h\":[8],\"g\":7,\"f\":6,\"e\":5,\"d\":4,\"c\":3,\"b\":2,\"i\":1}", 0);
+	TEST_EQUAL("{\"x\":0,\"a\":1,\"a\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7}",
+	           "{\"a\":1,\"a\":2,\"g\":7,\"f\":6,\"e\":5,\"d\":4,\"c\":3,\"x\":0}", 1);
+	TEST_EQUAL("{\"x\":0,\"a\":1,\"a\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7}",
+	           "{\"a\":2,\"a\":1,\"g\":7,\"f\":6,\"e\":5,\"d\":4,\"c\":3,\"x\":0}", 0);
+	TEST_EQUAL("{\"a\":2,\"a\":1,\"g\":7,\"f\":6,\"e\":5,\"d\":4,\"c\":3,\"x\":0}",
+	           "{\"x\":0,\"a\":1,\"a\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7}", 0);
+}
+
+static void test_hash() {
+	lept_value v1, v2, *p;
+	size_t i;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "[1,2]"));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "[2,1]"));
+	EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+	lept_free(&v2);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v2, "{\"1\":2}"));
+	EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+	lept_free(&v1);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v1, "{\"2\":1}"));
+	EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+	lept_free(&v1);
+	lept_free(&v2);
+
+	/* nesting this deep is walked without recursion */
+	lept_init(&v1);
+	lept_init(&v2);
+	lept_set_array(&v1, 0);
+	for (i = 0, p = &v1; i < 5000; i++) {
+		p = lept_pushback_array_element(p);
+		lept_set_array(p, 0);
+	}
+	lept_copy(&v2, &v1);
+	EXPECT_TRUE(lept_is_equal(&v1, &v2));
+	EXPECT_TRUE(lept_hash(&v1) == lept_hash(&v2));
+	lept_set_null(p);
+	EXPECT_FALSE(lept_is_equal(&v1, &v2));
+	EXPECT_TRUE(lept_hash(&v1) != lept_hash(&v2));
+	lept_free(&v1);
+	lept_free(&v2);
+}
+
+/*--------------------diff / patch--------------------*/
+static void test_diff_roundtrip(const char* json_a, const char* json_b, size_t expect_ops) {
+	lept_value a, b, patch, rest;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, json_a));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, json_b));
+	lept_init(&patch);
+	lept_diff(&a, &b, &patch);
+	EXPECT_EQ_SIZE_T(expect_ops, lept_get_array_size(&patch));
+	EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&a, &patch));
+	/* nothing is left to change once the patch is applied */
+	lept_init(&rest);
+	lept_diff(&a, &b, &rest);
+	EXPECT_EQ_SIZE_T(0, lept_get_array_size(&rest));
+	lept_free(&a);
+	lept_free(&b);
+	lept_free(&patch);
+	lept_free(&rest);
+}
+
+static void test_diff() {
+	test_diff_roundtrip("null", "null", 0);
+	test_diff_roundtrip("{\"a\":1,\"b\":[1,2]}", "{\"b\":[1,2],\"a\":1}", 0);
+	test_diff_roundtrip("0", "-0", 0);
+	test_diff_roundtrip("1", "\"1\"", 1);
+	test_diff_roundtrip("{\"a\":1,\"b\":2}", "{\"a\":1,\"c\":3}", 2);
+	test_diff_roundtrip("[1,2,3,4,5]", "[0,1,2,3,4,5]", 1);
+	test_diff_roundtrip("[0,1,2,3,4,5]", "[1,2,3,4,5]", 1);
+	test_diff_roundtrip("[1,2,3,4,5]", "[1,2,9,4,5]", 1);
+	test_diff_roundtrip("[1,2,3]", "[1,[2],3,4,5]", 3);
+	test_diff_roundtrip("{\"a/b\":{\"~c\":[1,{\"d\":true}]}}", "{\"a/b\":{\"~c\":[1,{\"d\":false}]}}", 1);
+	test_diff_roundtrip("{\"x\":[{\"k\":1},{\"k\":2}],\"y\":{}}", "{\"x\":[{\"k\":2}],\"y\":{\"z\":null}}", 2);
+}
+
+/* One change in a large document: diffing must cost about one walk, not a re-parse. */
+static void test_diff_large() {
+	const size_t count = 50000;
+	size_t i, size = count * 64;
+	char* json = (char*)malloc(size);
+	char* p = json;
+	lept_value a, b, patch;
+	std::chrono::steady_clock::time_point start;
+	double parse_seconds, diff_seconds;
+	for (*p++ = '[', i = 0; i < count; i++)
+		p += snprintf(p, json + size - p, "%s{\"id\":%d,\"tags\":[\"a\",%d],\"o\":{\"x\":1.5}}", i ? "," : "", (int)i, (int)i % 7);
+	snprintf(p, json + size - p, "]");
+	start = std::chrono::steady_clock::now();
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&a, json));
+	parse_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&b, json));
+	lept_set_number(lept_find_object_value(lept_get_array_element(&b, count / 2), "id", 2), -1.0);
+
+	lept_init(&patch);
+	start = std::chrono::steady_clock::now();
+	lept_diff(&a, &b, &patch);
+	diff_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	EXPECT_EQ_SIZE_T(1, lept_get_array_size(&patch));
+	EXPECT_TRUE(diff_seconds < 2 * parse_seconds);
+	EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&a, &patch));
+	EXPECT_TRUE(lept_is_equal(&a, &b));
+	lept_free(&a);
+	lept_free(&b);
+	lept_free(&patch);
+	free(json);
+}
+
+#define TEST_PATCH(error, expect, json, patch_json)\
+    do {\
+        lept_value v, p, e, rest;\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&p, patch_json));\
+        EXPECT_EQ_INT(error, lept_apply_patch(&v, &p));\
+        if (error == LEPT_PATCH_OK || expect[0] != '\0') {\
+            EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&e, expect));\
+            lept_init(&rest);\
+            lept_diff(&v, &e, &rest);\
+            EXPECT_EQ_SIZE_T(0, lept_get_array_size(&rest));\
+            lept_free(&e);\
+            lept_free(&rest);\
+        }\
+        lept_free(&v);\
+        lept_free(&p);\
+    } while(0)
+
+static void test_apply_patch() {
+	/* examples from RFC 6902 appendix A */
+	TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":\"bar\"}", "{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",\"qux\",\"baz\"]}", "{\"foo\":[\"bar\",\"baz\"]}", "[{\"op\":\"add\",\"path\":\"/foo/1\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\"}", "{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"remove\",\"path\":\"/baz\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"boo\",\"foo\":\"bar\"}", "{\"baz\":\"qux\",\"foo\":\"bar\"}", "[{\"op\":\"replace\",\"path\":\"/baz\",\"value\":\"boo\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":{\"bar\":\"baz\"},\"qux\":{\"corge\":\"grault\",\"thud\":\"fred\"}}",
+		"{\"foo\":{\"bar\":\"baz\",\"waldo\":\"fred\"},\"qux\":{\"corge\":\"grault\"}}",
+		"[{\"op\":\"move\",\"from\":\"/foo/waldo\",\"path\":\"/qux/thud\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"all\",\"cows\",\"eat\",\"grass\"]}", "{\"foo\":[\"all\",\"grass\",\"cows\",\"eat\"]}",
+		"[{\"op\":\"move\",\"from\":\"/foo/1\",\"path\":\"/foo/3\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}", "{\"baz\":\"qux\",\"foo\":[\"a\",2,\"c\"]}",
+		"[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"qux\"},{\"op\":\"test\",\"path\":\"/foo/1\",\"value\":2}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":\"bar\",\"child\":{\"grandchild\":{}}}", "{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/child\",\"value\":{\"grandchild\":{}}}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"foo\":[\"bar\",[\"abc\",\"def\"]]}", "{\"foo\":[\"bar\"]}", "[{\"op\":\"add\",\"path\":\"/foo/-\",\"value\":[\"abc\",\"def\"]}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"a\":[1,1]}", "{\"a\":[1]}", "[{\"op\":\"copy\",\"from\":\"/a/0\",\"path\":\"/a/-\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "[1]", "{}", "[{\"op\":\"replace\",\"path\":\"\",\"value\":[1]}]");
+
+	TEST_PATCH(LEPT_PATCH_TEST_FAILED, "", "{\"baz\":\"qux\"}", "[{\"op\":\"test\",\"path\":\"/baz\",\"value\":\"bar\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "", "{\"foo\":\"bar\"}", "[{\"op\":\"add\",\"path\":\"/baz/bat\",\"value\":\"qux\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "", "[1,2]", "[{\"op\":\"add\",\"path\":\"/3\",\"value\":3}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "", "[1,2]", "[{\"op\":\"remove\",\"path\":\"/01\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "", "{\"a\":1}", "[{\"op\":\"replace\",\"path\":\"/b\",\"value\":1}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "", "{}", "[{\"op\":\"get\",\"path\":\"\"}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "", "{}", "[{\"op\":\"add\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_INVALID_OPERATION, "", "{\"a\":{}}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a/b\"}]");
+
+	/* a move that cannot add leaves the source where it was; the source must exist even when moved onto itself */
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{\"a\":1}", "{\"a\":1}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/nope/x\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[1,2,3]", "[1,2,3]", "[{\"op\":\"move\",\"from\":\"/0\",\"path\":\"/3\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "[[],{}]", "[[],{}]", "[{\"op\":\"move\",\"from\":\"/0\",\"path\":\"/1/x\"}]");
+	TEST_PATCH(LEPT_PATCH_PATH_NOT_FOUND, "{}", "{}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "{\"a\":1}", "{\"a\":1}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"/a\"}]");
+	TEST_PATCH(LEPT_PATCH_OK, "[2]", "{\"a\":[2]}", "[{\"op\":\"move\",\"from\":\"/a\",\"path\":\"\"}]");
+}
+
+/* One patch against the same operations applied one by one, each with a fresh key index. */
+static void test_apply_patch_stepwise(const char* json, const char* patch_json) {
+	lept_value whole, stepwise, patch, op;
+	size_t i, length, expect_length;
+	char *expect, *actual;
+	int ret = LEPT_PATCH_OK;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&whole, json));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&stepwise, json));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&patch, patch_json));
+	for (i = 0; i < lept_get_array_size(&patch) && ret == LEPT_PATCH_OK; i++) {
+		lept_init(&op);
+		lept_set_array(&op, 1);
+		lept_copy(lept_pushback_array_element(&op), lept_get_array_element(&patch, i));
+		ret = lept_apply_patch(&stepwise, &op);
+		lept_free(&op);
+	}
+	EXPECT_EQ_INT(ret, lept_apply_patch(&whole, &patch));
+	/* member order counts too, so compare the CBOR bytes */
+	expect = lept_encode_cbor(&stepwise, &expect_length);
+	actual = lept_encode_cbor(&whole, &length);
+	EXPECT_EQ_SIZE_T(expect_length, length);
+	EXPECT_TRUE(expect_length == length && memcmp(expect, actual, length) == 0);
+	free(expect);
+	free(actual);
+	lept_free(&whole);
+	lept_free(&stepwise);
+	lept_free(&patch);
+}
+
+static void test_apply_patch_wide() {
+	static const char* wide = "{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7,\"i\":8,"
+		"\"w\":{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7},\"l\":[{\"a\":0,\"b\":1,\"c\":2,\"d\":3,\"e\":4,\"f\":5,\"g\":6,\"h\":7}]}";
+	lept_value v, patch;
+	char json[65536], *p;
+	size_t i;
+
+	test_apply_patch_stepwise(wide, "[{\"op\":\"remove\",\"path\":\"/c\"},{\"op\":\"test\",\"path\":\"/i\",\"value\":8},"
+		"{\"op\":\"add\",\"path\":\"/c\",\"value\":9},{\"op\":\"replace\",\"path\":\"/h\",\"value\":[]},{\"op\":\"test\",\"path\":\"/c\",\"value\":9}]");
+	/* growing past the index capacity, then removing everything added */
+	test_apply_patch_stepwise(wide, "[{\"op\":\"add\",\"path\":\"/j\",\"value\":1},{\"op\":\"add\",\"path\":\"/k\",\"value\":2},"
+		"{\"op\":\"add\",\"path\":\"/m\",\"value\":3},{\"op\":\"add\",\"path\":\"/n\",\"value\":4},{\"op\":\"remove\",\"path\":\"/a\"},"
+		"{\"op\":\"add\",\"path\":\"/o\",\"value\":5},{\"op\":\"add\",\"path\":\"/p\",\"value\":6},{\"op\":\"remove\",\"path\":\"/j\"},"
+		"{\"op\":\"test\",\"path\":\"/p\",\"value\":6},{\"op\":\"remove\",\"path\":\"/k\"},{\"op\":\"test\",\"path\":\"/i\",\"value\":8}]");
+	/* wide objects that are replaced, moved and copied must not leave stale indices behind */
+	test_apply_patch_stepwise(wide, "[{\"op\":\"test\",\"path\":\"/w/h\",\"value\":7},{\"op\":\"move\",\"from\":\"/w\",\"path\":\"/v\"},"
+		"{\"op\":\"remove\",\"path\":\"/v/a\"},{\"op\":\"copy\",\"from\":\"/v\",\"path\":\"/w\"},{\"op\":\"add\",\"path\":\"/w/z\",\"value\":1},"
+		"{\"op\":\"replace\",\"path\":\"/v\",\"value\":{\"a\":1,\"b\":2,\"c\":3,\"d\":4,\"e\":5,\"f\":6,\"g\":7,\"h\":8,\"i\":9}},"
+		"{\"op\":\"test\",\"path\":\"/v/i\",\"value\":9},{\"op\":\"move\",\"from\":\"/l/0/b\",\"path\":\"/l/0/y\"},"
+		"{\"op\":\"add\",\"path\":\"/l/0\",\"value\":0},{\"op\":\"test\",\"path\":\"/l/1/y\",\"value\":1},"
+		"{\"op\":\"move\",\"from\":\"/l/1\",\"path\":\"\"},{\"op\":\"test\",\"path\":\"/h\",\"value\":7}]");
+	test_apply_patch_stepwise(wide, "[{\"op\":\"move\",\"from\":\"/b\",\"path\":\"/nope/x\"},{\"op\":\"remove\",\"path\":\"/b\"}]");
+
+	/* replacing every member of a wide object, one lookup each */
+	for (p = json, i = 0; i < 1000; i++)
+		p += snprintf(p, json + sizeof(json) - p, "%s\"k%d\":%d", i ? "," : "{", (int)i, (int)i);
+	snprintf(p, json + sizeof(json) - p, "}");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+	for (p = json, i = 0; i < 1000; i++)
+		p += snprintf(p, json + sizeof(json) - p, "%s{\"op\":\"replace\",\"path\":\"/k%d\",\"value\":%d}", i ? "," : "[", (int)i, (int)i + 1);
+	snprintf(p, json + sizeof(json) - p, "]");
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&patch, json));
+	EXPECT_EQ_INT(LEPT_PATCH_OK, lept_apply_patch(&v, &patch));
+	EXPECT_EQ_DOUBLE(1000.0, lept_get_number(lept_find_object_value(&v, "k999", 4)));
+	lept_free(&v);
+	lept_free(&patch);
+}
+
+/*-----------------------document---------------------*/
+static void test_document() {
+	lept_document* doc;
+	const lept_value* root;
+	const lept_value* v;
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_document_parse(&doc, "{\"a\":1,\"b\":{\"a\":2,\"c\":[{\"a\":3}]},\"a\":4}"));
+	root = lept_document_get_root(doc);
+	EXPECT_EQ_DOUBLE(1.0, lept_get_number(lept_document_find_object_value(doc, root, "a", 1)));
+	v = lept_document_find_object_value(doc, root, "b", 1);
+	EXPECT_EQ_DOUBLE(2.0, lept_get_number(lept_document_find_object_value(doc, v, "a", 1)));
+	EXPECT_TRUE(lept_document_find_object_value(doc, v, "b", 1) == NULL);
+	v = lept_get_array_element(lept_document_find_object_value(doc, v, "c", 1), 0);
+	EXPECT_EQ_DOUBLE(3.0, lept_get_number(lept_document_find_object_value(doc, v, "a", 1)));
+	EXPECT_TRUE(lept_document_find_object_value(doc, root, "", 0) == NULL);
+
+	EXPECT_TRUE(lept_document_retain(doc) == doc);
+	lept_document_release(doc);
+	lept_document_release(doc);
+
+	EXPECT_EQ_INT(LEPT_PARSE_MISS_KEY, lept_document_parse(&doc, "{1:2}"));
+	EXPECT_TRUE(doc == NULL);
+}
+
+struct document_reader_state
+{
+	lept_document_slot* slot;
+	std::atomic<int> stop;
+	std::atomic<int> inconsistent;
+};
+
+static void document_reader(document_reader_state* s) {
+	while (!s->stop.load()) {
+		lept_document* doc = lept_document_slot_acquire(s->slot);
+		const lept_value* root = lept_document_get_root(doc);
+		const lept_value* version = lept_document_find_object_value(doc, root, "version", 7);
+		const lept_value* data = lept_document_find_object_value(doc, root, "data", 4);
+		if (lept_get_array_size(data) != (size_t)lept_get_number(version))
+			s->inconsistent.store(1);
+		lept_document_release(doc);
+	}
+}
+
+static void test_document_slot() {
+	document_reader_state s;
+	std::thread readers[4];
+	lept_value v;
+	int i;
+
+	lept_init(&v);
+	lept_set_object(&v, 0);
+	lept_set_number(lept_set_object_value(&v, "version", 7), 0);
+	lept_set_array(lept_set_object_value(&v, "data", 4), 0);
+	s.slot = lept_document_slot_create(lept_document_create(&v));
+	EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));
+	s.stop.store(0);
+	s.inconsistent.store(0);
+	for (i = 0; i < 4; i++)
+		readers[i] = std::thread(document_reader, &s);
+
+	/* each version is a private copy of the last one, edited and then published */
+	for (i = 1; i <= 50; i++) {
+		lept_document* doc = lept_document_slot_acquire(s.slot);
+		lept_copy(&v, lept_document_get_root(doc));
+		lept_document_release(doc);
+		lept_set_number(lept_find_object_value(&v, "version", 7), i);
+		lept_set_boolean(lept_pushback_array_element(lept_find_object_value(&v, "data", 4)), 1);
+		lept_document_slot_publish(s.slot, lept_document_create(&v));
+	}
+
+	s.stop.store(1);
+	for (i = 0; i < 4; i++)
+		readers[i].join();
+	EXPECT_FALSE(s.inconsistent.load());
+	lept_document_slot_destroy(s.slot);
+}
+
+/*-----------------------reformat---------------------*/
+#define TEST_REFORMAT(expect_minified, expect_pretty, json)\
+    do {\
+        char* out;\
+        size_t length;\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_validate(json));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(json, &out, &length));\
+        EXPECT_EQ_STRING(expect_minified, out, length);\
+        free(out);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_prettify(json, &out, &length));\
+        EXPECT_EQ_STRING(expect_pretty, out, length);\
+        free(out);\
+    } while(0)
+
+static void test_reformat() {
+	TEST_REFORMAT("null", "null", " null ");
+	TEST_REFORMAT("-1.5e+10", "-1.5e+10", "-1.5e+10");
+	TEST_REFORMAT("\"a \\n\\\"\"", "\"a \\n\\\"\"", "\"a \\n\\\"\"");
+	TEST_REFORMAT("[]", "[]", "[ ]");
+	TEST_REFORMAT("{}", "{}", " { } ");
+	TEST_REFORMAT("[1,[2],{}]", "[\n    1,\n    [\n        2\n    ],\n    {}\n]", "[ 1 , [ 2 ] , { } ]");
+	TEST_REFORMAT("{\"a\":true,\"b\":{\"c\":\"x y\"}}", "{\n    \"a\": true,\n    \"b\": {\n        \"c\": \"x y\"\n    }\n}",
+		"{ \"a\" :true,\n\t\"b\": { \"c\" : \"x y\" } }");
+}
+
+static const char* reformat_error_inputs[] = {
+	"", " ", "nul", "?", "+1", "1.", "INF", "[1,]", "[\"ab\", nul]", "null x", "0123", "1e309",
+	"\"", "\"abc", "\"\\v\"", "\"\x01\"", "[1", "[1}", "[1 2]", "{:1,", "{1:1,", "{\"a\":1,",
+	"{\"a\"}", "{\"a\",\"b\"}", "{\"a\":1", "{\"a\":1]", "{\"a\":1 \"b\"", "{\"a\":{}", "[[{\"a\":[1,2,}]]]"
+};
+
+static void append_sink(void* user, const char* s, size_t len) {
+	size_t* total = (size_t*)user;
+	EXPECT_TRUE(len > 0);
+	*total += len;
+	(void)s;
+}
+
+static void test_reformat_error() {
+	lept_value v;
+	char* out;
+	size_t i, length;
+	for (i = 0; i < sizeof(reformat_error_inputs) / sizeof(reformat_error_inputs[0]); i++) {
+		int expect = lept_parse(&v, reformat_error_inputs[i]);
+		EXPECT_TRUE(expect != LEPT_PARSE_OK);
+		EXPECT_EQ_INT(expect, lept_validate(reformat_error_inputs[i]));
+		EXPECT_EQ_INT(expect, lept_minify(reformat_error_inputs[i], &out, &length));
+		EXPECT_TRUE(out == NULL);
+		EXPECT_EQ_INT(expect, lept_prettify(reformat_error_inputs[i], &out, &length));
+		EXPECT_EQ_INT(expect, lept_json_to_cbor(reformat_error_inputs[i], &out, &length));
+		EXPECT_TRUE(out == NULL);
+	}
+
+	/* a sink receives the output in chunks once it outgrows the internal buffer */
+	{
+		char json[20000], *p = json;
+		size_t total = 0;
+		for (*p++ = '[', i = 0; i < 3000; i++)
+			p += snprintf(p, json + sizeof(json) - p, "%s%d", i ? ", " : "", (int)i);
+		snprintf(p, json + sizeof(json) - p, "]");
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_minify(json, &out, &length));
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_reformat(json, -1, append_sink, &total));
+		EXPECT_EQ_SIZE_T(length, total);
+		free(out);
+	}
+}
+
+/*-----------------------CBOR-------------------------*/
+#define TEST_CBOR_ROUNDTRIP(expect, json)\
+    do {\
+        char* cbor;\
+        char* text;\
+        char* encoded;\
+        size_t length, text_length, encoded_length;\
+        lept_value v;\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_json_to_cbor(json, &cbor, &length));\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));\
+        encoded = lept_encode_cbor(&v, &encoded_length);\
+        EXPECT_EQ_SIZE_T(encoded_length, length);\
+        EXPECT_TRUE(length == encoded_length && memcmp(cbor, encoded, length) == 0);\
+        EXPECT_EQ_INT(LEPT_PARSE_OK, lept_cbor_to_json(cbor, length, &text, &text_length));\
+        EXPECT_EQ_STRING(expect, text, text_length);\
+        lept_free(&v);\
+        free(encoded);\
+        free(cbor);\
+        free(text);\
+    } while(0)
+
+#define TEST_CBOR_ERROR(error, cbor)\
+    do {\
+        lept_value v;\
+        char* text;\
+        EXPECT_EQ_INT(error, lept_decode_cbor(&v, cbor, sizeof(cbor) - 1));\
+        EXPECT_EQ_INT(LEPT_NULL, lept_get_type(&v));\
+        EXPECT_EQ_INT(error, lept_cbor_to_json(cbor, sizeof(cbor) - 1, &text, NULL));\
+    } while(0)
+
+static void test_cbor_encode() {
+	static const char expect[] = "\x87\x01\x20\x61\x61\xf5\xf6\xfb\x3f\xf8\x00\x00\x00\x00\x00\x00\xa1\x61\x6b\xf4";
+	lept_value v;
+	char* cbor;
+	size_t length;
+	lept_init(&v);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, "[ 1, -1, \"a\", true, null, 1.5, { \"k\" : false } ]"));
+	cbor = lept_encode_cbor(&v, &length);
+	EXPECT_EQ_SIZE_T(sizeof(expect) - 1, length);
+	EXPECT_TRUE(length == sizeof(expect) - 1 && memcmp(expect, cbor, length) == 0);
+	lept_free(&v);
+
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_cbor(&v, cbor, length));
+	EXPECT_EQ_INT(LEPT_ARRAY, lept_get_type(&v));
+	EXPECT_EQ_SIZE_T(7, lept_get_array_size(&v));
+	EXPECT_EQ_DOUBLE(-1.0, lept_get_number(lept_get_array_element(&v, 1)));
+	EXPECT_EQ_STRING("a", lept_get_string(lept_get_array_element(&v, 2)), lept_get_string_length(lept_get_array_element(&v, 2)));
+	EXPECT_EQ_DOUBLE(1.5, lept_get_number(lept_get_array_element(&v, 5)));
+	EXPECT_EQ_STRING("k", lept_get_object_key(lept_get_array_element(&v, 6), 0), lept_get_object_key_length(lept_get_array_element(&v, 6), 0));
+	EXPECT_EQ_INT(LEPT_FALSE, lept_get_type(lept_get_object_value(lept_get_array_element(&v, 6), 0)));
+	lept_free(&v);
+	free(cbor);
+}
+
+static void test_cbor_decode() {
+	lept_value v;
+	/* half and single precision floats are accepted even though the encoder never emits them */
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_cbor(&v, "\xf9\x3e\x00", 3));
+	EXPECT_EQ_DOUBLE(1.5, lept_get_number(&v));
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_cbor(&v, "\xfa\x00\x00\x00\x01", 5));
+	EXPECT_TRUE(lept_get_number(&v) > 0.0);
+	EXPECT_EQ_INT(LEPT_PARSE_OK, lept_decode_cbor(&v, "\x3a\x00\x01\x86\x9f", 5));
+	EXPECT_EQ_DOUBLE(-100000.0, lept_get_number(&v));
+}
+
+static void test_cbor_roundtrip() {
+	TEST_CBOR_ROUNDTRIP("null", " null ");
+	TEST_CBOR_ROUNDTRIP("0", "0");
+	TEST_CBOR_ROUNDTRIP("-0", "-0");
+	TEST_CBOR_ROUNDTRIP("4294967296", "4294967296");
+	TEST_CBOR_ROUNDTRIP("-1.5e-10", "-1.5e-10");
+	TEST_CBOR_ROUNDTRIP("\"Hello\\nWorld\"", "\"Hello\\nWorld\"");
+	TEST_CBOR_ROUNDTRIP("[]", "[ ]");
+	TEST_CBOR_ROUNDTRIP("{}", "{ }");
+	TEST_CBOR_ROUNDTRIP("[null,false,true,123,\"abc\",[1,2],{\"a\":{}}]", "[ null , false , true , 123 , \"abc\" , [ 1, 2 ] , { \"a\" : { } } ]");
+	TEST_CBOR_ROUNDTRIP("[[[[]],{}],{\"\":[{}]}]", "[[[[]],{}],{\"\":[{}]}]");
+
+	/* counts past 23 and 255 need wider heads than the nested ones inside them */
+	{
+		char json[32768], *p = json;
+		char* cbor;
+		char* encoded;
+		size_t i, length, encoded_length;
+		lept_value v;
+		for (*p++ = '[', i = 0; i < 300; i++)
+			p += snprintf(p, json + sizeof(json) - p, "%s[%d,{\"k%d\":\"%*s\"}]", i ? "," : "", (int)i, (int)i, (int)(i % 40), "");
+		snprintf(p, json + sizeof(json) - p, "]");
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_json_to_cbor(json, &cbor, &length));
+		EXPECT_EQ_INT(LEPT_PARSE_OK, lept_parse(&v, json));
+		encoded = lept_encode_cbor(&v, &encoded_length);
+		EXPECT_EQ_SIZE_T(encoded_length, length);
+		EXPECT_TRUE(length == encoded_length && memcmp(cbor, encoded, length) == 0);
+		lept_free(&v);
+		free(encoded);
+		free(cbor);
+	}
+}
+
+static void test_cbor_error() {
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x83\x01\x02");         /* truncated array */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x63\x61\x62");         /* truncated text */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\xa1\x01\x02");         /* key is not text */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x9f\xff");             /* indefinite length */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\xf7");                 /* undefined */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x42\x00\x00");         /* byte string */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\xf9\x7e\x00");         /* NaN */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x61\x01");             /* control byte with no JSON escape */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\xa1\x61\x1f\xf6");     /* the same in a key */
+	TEST_CBOR_ERROR(LEPT_PARSE_INVALID_CBOR, "\x9b\xff\xff\xff\xff\xff\xff\xff\xff");
+	TEST_CBOR_ERROR(LEPT_PARSE_ROOT_NOT_SINGULAR, "\xf6\xf6");
+
+	char* cbor;
+	size_t length;
+	EXPECT_EQ_INT(LEPT_PARSE_INVALID_VALUE, lept_json_to_cbor("[1,]", &cbor, &length));
+	EXPECT_TRUE(cbor == NULL);
+}
+
 /*----------------------------------------------------*/
 void test_all() {
 	test_parse_null();
@@ -304,14 +1145,41 @@ void test_all() {
 	test_access_boolean();
 	test_access_number();
 	test_access_string();
+	test_access_array();
+	test_access_object();
+	test_copy_move_swap();
 
 
 	test_parse_miss_key();
 	test_parse_miss_colon();
 	test_parse_miss_comma_or_curly_bracket();
+	test_parse_error_position();
+
+	test_parse_parallel();
+
+	test_equal();
+	test_hash();
+
+	test_diff();
+	test_diff_large();
+	test_apply_patch();
+	test_apply_patch_wide();
+
+	test_document();
+	test_document_slot();
+
+	test_reformat();
+	test_reformat_error();
+
+	test_cbor_encode();
+	test_cbor_decode();
+	test_cbor_roundtrip();
+	test_cbor_error();
 }
 int main() {
+#ifdef _MSC_VER
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
 
 	test_all();
 	//test_parse_miss_key();